@@ -3,6 +3,7 @@
 #include "tnnf/ListenerSocket.hpp"
 #include "tnnf/ClientSocket.hpp"
 #include "tnnf/Selector.hpp"
+#include "tnnf/EpollSelector.hpp"
 
 void server() {
     tnnf::Address listenerAddress("127.0.0.1", 25565); //We use the loopback address.
@@ -86,8 +87,38 @@ void selector() {
     }
 }
 
+void callbackSelector() {
+    tnnf::PacketBuffer buffer;
+    tnnf::ListenerSocket listener(tnnf::Address("127.0.0.1", 25565), 10);
+    tnnf::EpollSelector selector(nullptr, nullptr, nullptr); //no arrays, every socket has its own handlers
+
+    tnnf::SocketHandlers clientHandlers;
+    clientHandlers.onReadable = [&](tnnf::Socket& sock) { //called only for the clients
+        if(!sock.drain(buffer)) { //hang up
+            selector.remove(sock);
+            return;
+        }
+
+        while(buffer.isPacketStored()) {
+            tnnf::Packet receivedPacket = buffer.getPacket();
+
+            std::cout << receivedPacket.getType() << " - " << receivedPacket.getData() << std::endl;
+        }
+    };
+
+    tnnf::SocketHandlers listenerHandlers;
+    listenerHandlers.onReadable = [&](tnnf::Socket&) { //called only for the listener
+        tnnf::TcpSocket newClient = listener.accept();
+        selector.add(newClient, clientHandlers);
+    };
+
+    selector.setTimeout(-1, 0); //wait until something happens
+    selector.add(listener, listenerHandlers);
+    selector.run(); //until selector.stop()
+}
+
 int main() {
-	std::cout << "0: TcpServer, 1: TcpClient, 2: TcpSelectorServer" << std::endl;
+	std::cout << "0: TcpServer, 1: TcpClient, 2: TcpSelectorServer, 3: TcpCallbackServer" << std::endl;
 
     int question = 0;	
     std::cin >> question;
@@ -101,6 +132,9 @@ int main() {
     if(question == 2) {
         selector();
     }
+    if(question == 3) {
+        callbackSelector();
+    }
 
     return 0;
 }
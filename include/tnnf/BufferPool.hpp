@@ -0,0 +1,158 @@
+/*! \file BufferPool.hpp
+    \brief Receive buffers shared by the connections of a loop.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef TNNF_BUFFERPOOL_HPP
+#define TNNF_BUFFERPOOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace tnnf {
+    /*! \class BufferPool
+        \brief The receive memory of the pooled PacketBuffers of one loop.
+
+        Every read goes into one scratch buffer, and the complete packets are built from there.
+        A PacketBuffer borrows its own buffer only while it holds an incomplete packet, and gives it
+        back when it is empty, so an idle connection does not hold any receive memory. The borrowed
+        buffers come in size classes from 4 KiB to 64 KiB, and they are kept for reuse until trim().
+
+        It is not thread safe, use one on every thread (for example one in every Reactor),
+        and keep it alive while its PacketBuffers live:
+        \code
+        tnnf::BufferPool pool;
+        tnnf::PacketBuffer buffer(pool); //no memory until a packet is split between two reads
+        \endcode*/
+    class BufferPool {
+        public:
+            static const size_t CLASSES = 3;            //!< number of the size classes
+            static const size_t SMALLEST = 4096;        //!< size of the smallest class, every class is 4 times bigger
+
+        private:
+            std::vector<char*> mFree[CLASSES]; //given back buffers of the classes
+            std::unique_ptr<char[]> mScratch; //every read lands here first
+            size_t mScratchSize;
+            size_t mBorrowed; //number of the buffers which are not given back
+
+        protected:
+
+        public:
+            /*! \fn BufferPool(const size_t& scratchSize = 65536)
+                \brief Constructor.
+                \param scratchSize The longest read of a PacketBuffer which does not hold an incomplete packet.*/
+            explicit BufferPool(const size_t& scratchSize = 65536) :
+                mScratch(new char[scratchSize]),
+                mScratchSize(scratchSize),
+                mBorrowed(0)
+            {}
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The PacketBuffers refer to the pool.*/
+            BufferPool(const BufferPool& other) = delete;
+            BufferPool& operator=(const BufferPool& other) = delete;
+            BufferPool(BufferPool&& other) = delete;
+            BufferPool& operator=(BufferPool&& other) = delete;
+
+            /*! \fn ~BufferPool()
+                \brief Destructor. Frees the given back buffers, the borrowed ones has to be given back before.*/
+            ~BufferPool() {
+                trim();
+            }
+
+            /*! \fn static size_t GetClassSize(const size_t& index)
+                \return the size of the buffers of a class*/
+            static size_t GetClassSize(const size_t& index) noexcept {
+                return SMALLEST << (2 * index);
+            }
+
+            /*! \fn char* acquire(const size_t& size, size_t& capacity)
+                \brief Borrows a buffer of the smallest class which is not smaller than size.
+                \param size At most GetClassSize(CLASSES - 1).
+                \param capacity Set to the size of the buffer.
+                \return the buffer, which has to be given back with release()*/
+            char* acquire(const size_t& size, size_t& capacity) {
+                size_t index = 0;
+                while(index < CLASSES - 1 && GetClassSize(index) < size) {
+                    index++;
+                }
+
+                capacity = GetClassSize(index);
+                mBorrowed++;
+
+                if(mFree[index].empty()) {
+                    return new char[capacity];
+                }
+
+                char* buffer = mFree[index].back();
+                mFree[index].pop_back();
+                return buffer;
+            }
+
+            /*! \fn void release(char* buffer, const size_t& capacity)
+                \brief Gives back a buffer of acquire(), it is kept for the next one.
+                \param buffer
+                \param capacity The capacity which was set by acquire().*/
+            void release(char* buffer, const size_t& capacity) {
+                size_t index = 0;
+                while(index < CLASSES - 1 && GetClassSize(index) < capacity) {
+                    index++;
+                }
+
+                mBorrowed--;
+                mFree[index].push_back(buffer);
+            }
+
+            /*! \fn void trim()
+                \brief Frees the given back buffers, for example after a traffic peak.*/
+            void trim() noexcept {
+                for(auto& i : mFree) {
+                    for(auto& j : i) {
+                        delete[] j;
+                    }
+                    i.clear();
+                    i.shrink_to_fit();
+                }
+            }
+
+            /*! \fn char* getScratch()
+                \return the buffer of the reads, its content is valid only until the next read*/
+            char* getScratch() noexcept {
+                return mScratch.get();
+            }
+
+            /*! \fn size_t getScratchSize()
+                \return the size of getScratch()*/
+            size_t getScratchSize() const noexcept {
+                return mScratchSize;
+            }
+
+            /*! \fn size_t getBorrowed()
+                \return the number of the borrowed buffers, the connections with an incomplete packet*/
+            size_t getBorrowed() const noexcept {
+                return mBorrowed;
+            }
+    };
+}//tnnf
+
+#endif
@@ -0,0 +1,409 @@
+/*! \file Coroutine.hpp
+    \brief C++20 coroutines, which wait for the sockets of an EpollSelector.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_COROUTINE_HPP
+#define TNNF_COROUTINE_HPP
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <string>
+
+#include "EpollSelector.hpp"
+#include "ListenerSocket.hpp"
+#include "Packet.hpp"
+#include "PacketBuffer.hpp"
+#include "Socket.hpp"
+#include "TcpSocket.hpp"
+
+namespace tnnf {
+    /*! \class FramePool
+        \brief Memory of the coroutine frames. The freed frames are kept in free lists of
+            64 byte size classes, so after the first connections a new coroutine does not
+            touch the heap. Every thread has its own lists, a frame can be freed on any thread.
+            Frames bigger than MAX_SIZE are allocated with new.*/
+    class FramePool {
+        private:
+            static const size_t GRANULARITY = 64; //size of a class
+            static const size_t MAX_SIZE = 4096; //bigger frames are not pooled
+
+            // A free frame.
+            struct Node {
+                Node* next;
+            };
+
+            Node* mFree[MAX_SIZE / GRANULARITY]; //free lists of the size classes
+
+            FramePool() noexcept {
+                for(auto& i : mFree) {
+                    i = nullptr;
+                }
+            }
+
+            ~FramePool() {
+                for(auto& i : mFree) {
+                    while(i != nullptr) {
+                        Node* next = i->next;
+                        ::operator delete(i);
+                        i = next;
+                    }
+                }
+            }
+
+            // The pool of the current thread.
+            static FramePool& get() noexcept {
+                thread_local FramePool pool;
+                return pool;
+            }
+
+        protected:
+
+        public:
+            /*! \fn static void* allocate(const size_t& size)
+                \param size
+                \return a frame from the free list of its size class, or a new one*/
+            static void* allocate(const size_t& size) {
+                if(size > MAX_SIZE) {
+                    return ::operator new(size);
+                }
+
+                size_t index = (size - 1) / GRANULARITY;
+                Node*& head = get().mFree[index];
+
+                if(head == nullptr) {
+                    return ::operator new((index + 1) * GRANULARITY);
+                }
+
+                Node* node = head;
+                head = node->next;
+                return node;
+            }
+
+            /*! \fn static void deallocate(void* frame, const size_t& size)
+                \brief Puts a frame to the free list of its size class.
+                \param frame The result of allocate().
+                \param size The same size as at allocate().*/
+            static void deallocate(void* frame, const size_t& size) noexcept {
+                if(size > MAX_SIZE) {
+                    ::operator delete(frame);
+                    return;
+                }
+
+                Node*& head = get().mFree[(size - 1) / GRANULARITY];
+                Node* node = static_cast<Node*>(frame);
+                node->next = head;
+                head = node;
+            }
+    };
+
+    /*! \struct Task
+        \brief A coroutine which starts at once and destroys itself when it returns.
+            Nobody waits for it, so the exceptions are not allowed to leave it.
+            Its frame is allocated from the FramePool.
+            \code
+            tnnf::Task session(tnnf::EpollSelector& selector, tnnf::TcpSocket client) {
+                tnnf::PacketBuffer buffer;
+                tnnf::Packet packet;
+
+                selector.watch(client);
+
+                while(co_await tnnf::receivePacket(selector, client, buffer, packet)) {
+                    if(!co_await tnnf::sendAsync(selector, client, packet)) {
+                        break;
+                    }
+                }
+
+                selector.remove(client);
+            }
+            \endcode*/
+    struct Task {
+        struct promise_type {
+            Task get_return_object() noexcept { return Task(); }
+            std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+            std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+
+            static void* operator new(size_t size) { return FramePool::allocate(size); }
+            static void operator delete(void* frame, size_t size) noexcept { FramePool::deallocate(frame, size); }
+        };
+    };
+
+    /*! \class AcceptAwaitable
+        \brief The result of acceptAsync().*/
+    class AcceptAwaitable {
+        private:
+            // Accept a waiting connection, false if it has to wait.
+            bool tryAccept() {
+                TcpSocket client = mListener.tryAccept();
+
+                if(client.getSocket() == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return false;
+                }
+                if(client.getSocket() != -1) {
+                    mResult.emplace(std::move(client));
+                }
+                return true;
+            }
+
+            // Called by the selector when the listener is readable.
+            void onReady() {
+                if(mSelector.find(mHandle) != nullptr && !tryAccept()
+                        && mSelector.waitReadable(mListener, [this]() { onReady(); })) {
+                    return;
+                }
+                mCoroutine.resume();
+            }
+
+            EpollSelector& mSelector;
+            ListenerSocket& mListener;
+            SocketHandle mHandle; //the listener could be removed while it waits
+            std::coroutine_handle<> mCoroutine;
+            std::optional<TcpSocket> mResult;
+
+        protected:
+
+        public:
+            AcceptAwaitable(EpollSelector& selector, ListenerSocket& listener) noexcept :
+                mSelector(selector),
+                mListener(listener),
+                mHandle(0)
+            {
+
+            }
+
+            bool await_ready() {
+                return tryAccept();
+            }
+
+            bool await_suspend(std::coroutine_handle<> coroutine) noexcept {
+                mCoroutine = coroutine;
+                mHandle = mSelector.getHandle(mListener);
+                return mSelector.waitReadable(mListener, [this]() { onReady(); });
+            }
+
+            std::optional<TcpSocket> await_resume() noexcept {
+                return std::move(mResult);
+            }
+    };
+
+    /*! \class ReceiveAwaitable
+        \brief The result of receivePacket().*/
+    class ReceiveAwaitable {
+        private:
+            // Read what is available, false if it has to wait.
+            bool tryReceive() {
+                if(mBuffer.isPacketStored()) {
+                    return true;
+                }
+                if(!mSocket.drain(mBuffer)) {
+                    mFailed = true;
+                    return true;
+                }
+                return mBuffer.isPacketStored();
+            }
+
+            // Called by the selector when the socket is readable.
+            void onReady() {
+                if(mSelector.find(mHandle) == nullptr) {
+                    mFailed = true;
+                }
+                else if(!tryReceive() && mSelector.waitReadable(mSocket, [this]() { onReady(); })) {
+                    return;
+                }
+                mCoroutine.resume();
+            }
+
+            EpollSelector& mSelector;
+            Socket& mSocket;
+            PacketBuffer& mBuffer;
+            Packet& mPacket;
+            SocketHandle mHandle; //the socket could be removed while it waits
+            std::coroutine_handle<> mCoroutine;
+            bool mFailed;
+
+        protected:
+
+        public:
+            ReceiveAwaitable(EpollSelector& selector, Socket& sock, PacketBuffer& buffer, Packet& packet) noexcept :
+                mSelector(selector),
+                mSocket(sock),
+                mBuffer(buffer),
+                mPacket(packet),
+                mHandle(0),
+                mFailed(false)
+            {
+
+            }
+
+            bool await_ready() {
+                return tryReceive();
+            }
+
+            bool await_suspend(std::coroutine_handle<> coroutine) noexcept {
+                mCoroutine = coroutine;
+                mHandle = mSelector.getHandle(mSocket);
+
+                if(!mSelector.waitReadable(mSocket, [this]() { onReady(); })) {
+                    mFailed = true;
+                    return false;
+                }
+                return true;
+            }
+
+            bool await_resume() {
+                if(mFailed && !mBuffer.isPacketStored()) {
+                    return false;
+                }
+
+                mPacket = mBuffer.getPacket();
+                return true;
+            }
+    };
+
+    /*! \class SendAwaitable
+        \brief The result of sendAsync().*/
+    class SendAwaitable {
+        private:
+            // Send what the kernel takes, false if it has to wait.
+            bool trySend() noexcept {
+                while(mOffset < mData.size()) {
+                    ssize_t sent = ::send(mSocket.getSocket(), mData.data() + mOffset, mData.size() - mOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+                    if(sent >= 0) {
+                        mOffset += sent;
+                    }
+                    else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                        return false;
+                    }
+                    else if(errno != EINTR) {
+                        gSocketErrorFunction(mSocket, ERROR_SOCKET_SEND, errno);
+                        mFailed = true;
+                        return true;
+                    }
+                }
+                return true;
+            }
+
+            // Called by the selector when the socket is writable.
+            void onReady() {
+                if(mSelector.find(mHandle) == nullptr) {
+                    mFailed = true;
+                }
+                else if(!trySend() && mSelector.waitWritable(mSocket, [this]() { onReady(); })) {
+                    return;
+                }
+                mCoroutine.resume();
+            }
+
+            EpollSelector& mSelector;
+            Socket& mSocket;
+            std::string mData; //the serialized packet
+            size_t mOffset; //the sent part of mData
+            SocketHandle mHandle; //the socket could be removed while it waits
+            std::coroutine_handle<> mCoroutine;
+            bool mFailed;
+
+        protected:
+
+        public:
+            SendAwaitable(EpollSelector& selector, Socket& sock, const Packet& packet) :
+                mSelector(selector),
+                mSocket(sock),
+                mOffset(0),
+                mHandle(0),
+                mFailed(false)
+            {
+                packet.serialize(mData);
+            }
+
+            bool await_ready() noexcept {
+                return trySend();
+            }
+
+            bool await_suspend(std::coroutine_handle<> coroutine) noexcept {
+                mCoroutine = coroutine;
+                mHandle = mSelector.getHandle(mSocket);
+
+                if(!mSelector.waitWritable(mSocket, [this]() { onReady(); })) {
+                    mFailed = true;
+                    return false;
+                }
+                return true;
+            }
+
+            bool await_resume() noexcept {
+                return !mFailed;
+            }
+    };
+
+    /*! \fn AcceptAwaitable acceptAsync(EpollSelector& selector, ListenerSocket& listener)
+        \brief co_await accepts a connection, the coroutine is suspended until one arrives:
+            \code
+            listener.setBlocking(false);
+            selector.watch(listener);
+
+            while(std::optional<tnnf::TcpSocket> client = co_await tnnf::acceptAsync(selector, listener)) {
+                session(selector, std::move(*client));
+            }
+            \endcode
+        \param selector The listener has to be added to it.
+        \param listener It has to be non-blocking, see Socket::setBlocking().
+        \return the awaitable, which results the accepted socket, or nothing if the accept failed
+            or the listener was removed*/
+    inline AcceptAwaitable acceptAsync(EpollSelector& selector, ListenerSocket& listener) noexcept {
+        return AcceptAwaitable(selector, listener);
+    }
+
+    /*! \fn ReceiveAwaitable receivePacket(EpollSelector& selector, Socket& sock, PacketBuffer& buffer, Packet& packet)
+        \brief co_await takes the next packet from the buffer. If there is none, it reads
+            without blocking, and the coroutine is suspended until a whole packet arrives.
+        \param selector The socket has to be added to it.
+        \param sock A stream socket.
+        \param buffer It keeps the bytes of the next packets between the calls.
+        \param packet The received packet.
+        \return the awaitable, which results false if the connection hung up or failed, or the socket was removed*/
+    inline ReceiveAwaitable receivePacket(EpollSelector& selector, Socket& sock, PacketBuffer& buffer, Packet& packet) noexcept {
+        return ReceiveAwaitable(selector, sock, buffer, packet);
+    }
+
+    /*! \fn SendAwaitable sendAsync(EpollSelector& selector, Socket& sock, const Packet& packet)
+        \brief co_await sends a packet without blocking the loop. The coroutine is suspended
+            until the kernel has taken the whole packet. Do not mix it with EpollSelector::send()
+            on the same socket, their bytes could interleave.
+        \param selector The socket has to be added to it.
+        \param sock A stream socket.
+        \param packet It is copied, so it can be a temporary.
+        \return the awaitable, which results false if the sending failed or the socket was removed*/
+    inline SendAwaitable sendAsync(EpollSelector& selector, Socket& sock, const Packet& packet) {
+        return SendAwaitable(selector, sock, packet);
+    }
+}//tnnf
+
+#endif // C++20
+
+#endif
@@ -0,0 +1,1311 @@
+/*! \file EpollSelector.hpp
+    \brief Storing sockets and following their state with epoll.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_EPOLLSELECTOR_HPP
+#define TNNF_EPOLLSELECTOR_HPP
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LoopStats.hpp"
+#include "MpscQueue.hpp"
+#include "ObjectPool.hpp"
+#include "Socket.hpp"
+#include "SocketTable.hpp"
+#include "StoredSocket.hpp"
+#include "TimerWheel.hpp"
+#include "tnnf.hpp"
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+namespace tnnf {
+    typedef std::function<void(Socket&)> SocketHandler; //called with the stored socket
+    typedef std::function<void()> SelectorTask; //posted from another thread, called by update()
+
+    /*! \struct SocketHandlers
+        \brief The callbacks of a socket, which are called by EpollSelector::update().
+            Only the events with a handler are watched.*/
+    struct SocketHandlers {
+        SocketHandler onReadable; //!< data arrived, a connection is waiting, or the socket is hung up
+        SocketHandler onWritable; //!< the socket is connected, or the packets of EpollSelector::send() are sent
+        SocketHandler onClosed; //!< the peer closed the connection, or an error occurred
+    };
+
+    /*! \class EpollSelector
+        \brief A Selector driven by epoll.
+
+        It has the same interface as Selector, so a loop written for Selector
+        works without changes. The sockets are registered in the kernel once
+        in add() and unregistered in remove(), and update() only walks the sockets
+        which are ready, so the cost of an update does not depend on the number of
+        the watched sockets. There is no FD_SETSIZE limit.
+
+        Hang up and error events are reported as readable (receive() will report them
+        through the socket error callback), errors are reported as writable and faulty too.
+
+        It has timers too, which are called from update(). The wait of update() is cut short
+        by the nearest timer, and it is not reported as a timeout:
+        \code
+        tnnf::TimerId idle = selector.addTimer(30000, [&]() { //30 seconds
+            selector.remove(client);
+        });
+
+        selector.cancelTimer(idle); //the client sent something
+        \endcode
+
+        Instead of the arrays a socket can have its own handlers, which are called directly
+        from update(), so nothing has to be compared and no array is filled:
+        \code
+        selector.add(listener, tnnf::SocketHandlers{[&](tnnf::Socket&) {
+            tnnf::TcpSocket client = listener.accept();
+
+            selector.add(client, tnnf::SocketHandlers{[&](tnnf::Socket& sock) {
+                if(!sock.drain(buffer)) {
+                    selector.remove(sock);
+                }
+            }});
+        }});
+
+        selector.run(); //until selector.stop()
+        \endcode
+
+        Other threads can hand work over to the thread of the loop with post(), for example
+        a reply through the handle of a socket:
+        \code
+        tnnf::SocketHandle handle = selector.getHandle(client);
+
+        std::thread worker([&selector, handle]() {
+            tnnf::Packet reply(1, "done");
+
+            selector.post([&selector, handle, reply]() {
+                if(tnnf::Socket* sock = selector.find(handle)) { //it could be removed since
+                    sock->send(reply);
+                }
+            });
+        });
+        \endcode*/
+    class EpollSelector {
+        private:
+            // A watched socket, allocated from mPool.
+            struct Registration {
+                StoredSocket socket; //the stored copy, or the watched socket
+                SocketHandlers handlers;
+                std::string outbound; //serialized packets of send(), which the kernel did not take yet
+                size_t outboundOffset; //the sent part of outbound
+                bool callbacks; //it was added with handlers, the arrays are not used
+                bool removed; //removed while the events were dispatched
+                bool writeWanted; //onWritable waits for the next writable event
+                bool writeWatched; //EPOLLOUT is in the interest in the kernel
+                bool awaited; //watched edge-triggered for the waiters, the arrays are not used
+                SelectorTask readWaiter; //of waitReadable(), called once
+                SelectorTask writeWaiter; //of waitWritable(), called once
+                uint64_t readyTurn; //the turn of update() when it is served from the ready list, 0 if it is not in the list
+            };
+
+            // Clear all user provided arrays.
+            void clearTemp() noexcept {
+                if(mWritable != nullptr) {
+                    mWritable->clear();
+                }
+                if(mReadable != nullptr) {
+                    mReadable->clear();
+                }
+                if(mFaulty != nullptr) {
+                    mFaulty->clear();
+                }
+            }
+
+            // The events which has to be watched, depends on the handlers or on which arrays are set.
+            // EPOLLOUT is watched only while something waits for it, it would be reported all the time.
+            uint32_t getInterest(const Registration& registration) const noexcept {
+                uint32_t events = 0;
+
+                if(registration.awaited) {
+                    return EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                }
+                if(registration.callbacks) {
+                    if(registration.handlers.onReadable) {
+                        events |= EPOLLIN;
+                    }
+                    if(registration.writeWanted) {
+                        events |= EPOLLOUT;
+                    }
+                    if(registration.handlers.onClosed) {
+                        events |= EPOLLRDHUP;
+                    }
+                }
+                else {
+                    if(mReadable != nullptr) {
+                        events |= EPOLLIN;
+                    }
+                    if(mFaulty != nullptr) {
+                        events |= EPOLLPRI;
+                    }
+                }
+                if(registration.outboundOffset < registration.outbound.size()) {
+                    events |= EPOLLOUT;
+                }
+                if(mEdgeTriggered) {
+                    events |= EPOLLET;
+                }
+
+                return events;
+            }
+
+            // Apply the current interest to all registered sockets.
+            void updateInterest() noexcept {
+                epoll_event event;
+
+                for(auto& i : mRegistrations.getDescriptors()) {
+                    Registration* registration = *mRegistrations.find(i);
+                    event.events = getInterest(*registration);
+                    event.data.u64 = mRegistrations.getHandle(i);
+                    registration->writeWatched = (event.events & EPOLLOUT) != 0;
+
+                    mSyscalls++;
+                    if(epoll_ctl(mEpoll, EPOLL_CTL_MOD, i, &event) == -1) {
+                        gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not modify a socket.");
+                    }
+                }
+            }
+
+            // Register a descriptor in the kernel. The caller puts the socket into the result.
+            Registration* insert(const int& fd, const SocketHandlers* handlers) noexcept {
+                Registration* registration = mPool.create();
+                registration->outboundOffset = 0;
+                registration->callbacks = handlers != nullptr;
+                registration->removed = false;
+                registration->writeWanted = false;
+                registration->awaited = false;
+                registration->readyTurn = 0;
+                if(handlers != nullptr) {
+                    registration->handlers = *handlers;
+                    registration->writeWanted = (bool) handlers->onWritable; //called once when it is connected
+                }
+
+                epoll_event event;
+                event.events = getInterest(*registration);
+                event.data.u64 = mRegistrations.insert(fd, registration); //the handle, 0 if it is already added
+                registration->writeWatched = (event.events & EPOLLOUT) != 0;
+
+                mSyscalls++;
+                if(event.data.u64 == 0 || epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) == -1) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not add a socket.");
+                    if(event.data.u64 != 0) {
+                        mRegistrations.erase(fd);
+                    }
+                    mPool.destroy(registration);
+                    return nullptr;
+                }
+
+                if(registration->callbacks) {
+                    mHandled++;
+                }
+                return registration;
+            }
+
+            // Unregister a socket. While the events are dispatched, the memory is freed only after it.
+            void release(int fd) noexcept {
+                Registration* registration = *mRegistrations.find(fd);
+
+                mRegistrations.erase(fd); //the events of it in the current batch are skipped
+                epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+                mSyscalls++;
+
+                if(registration->callbacks || registration->awaited) {
+                    mHandled--;
+                }
+                if(registration->readWaiter) { //they find out that the socket is removed
+                    post(std::move(registration->readWaiter));
+                }
+                if(registration->writeWaiter) {
+                    post(std::move(registration->writeWaiter));
+                }
+
+                if(mDispatching) {
+                    registration->removed = true;
+                    mRemoved.push_back(registration);
+                    return;
+                }
+
+                mPool.destroy(registration);
+            }
+
+            // Free the sockets which were removed by the handlers.
+            void collect() noexcept {
+                for(auto& i : mRemoved) {
+                    mPool.destroy(i);
+                }
+                mRemoved.clear();
+            }
+
+            // Call the handlers of a socket. The socket can be removed by any of them.
+            void dispatch(Registration& registration, const uint32_t& events) {
+                SocketHandlers& handlers = registration.handlers;
+                Socket& sock = *registration.socket.get();
+
+                if(handlers.onReadable && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                    handlers.onReadable(sock);
+                }
+                if(!registration.removed && registration.writeWanted && (events & (EPOLLOUT | EPOLLERR))
+                        && registration.outboundOffset == registration.outbound.size()) {
+                    registration.writeWanted = false;
+                    updateWriteInterest(registration);
+                    handlers.onWritable(sock);
+                }
+                if(!registration.removed && handlers.onClosed && (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    handlers.onClosed(sock);
+                }
+            }
+
+            // Call the waiters of a socket once. The socket can be removed by any of them.
+            void wake(Registration& registration, const uint32_t& events) {
+                if(registration.readWaiter && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    SelectorTask waiter = std::move(registration.readWaiter); //it can wait again
+                    registration.readWaiter = nullptr;
+                    waiter();
+                }
+                if(!registration.removed && registration.writeWaiter && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))) {
+                    SelectorTask waiter = std::move(registration.writeWaiter);
+                    registration.writeWaiter = nullptr;
+                    waiter();
+                }
+            }
+
+            // Call the waiters or the handlers of a socket, and measure them.
+            void call(Registration& registration, const uint32_t& events) {
+                std::chrono::steady_clock::time_point handlerStart;
+                if(mStatsEnabled) {
+                    handlerStart = std::chrono::steady_clock::now();
+                }
+
+                if(registration.awaited) {
+                    wake(registration, events);
+                }
+                else {
+                    dispatch(registration, events);
+                }
+
+                if(mStatsEnabled) {
+                    mMailbox->stats.handlerTime.record(getNanoseconds(handlerStart, std::chrono::steady_clock::now()));
+                }
+            }
+
+            // Put a socket without handlers into the user provided arrays. It is writable when the queue of send() is drained.
+            void report(Registration& registration, const uint32_t& events) {
+                Socket* sock = registration.socket.get();
+
+                if(mReadable != nullptr && (events & (EPOLLIN | EPOLLHUP | EPOLLRDHUP | EPOLLERR))) {
+                    mReadable->push_back(sock);
+                }
+                if(mWritable != nullptr && (events & (EPOLLOUT | EPOLLERR)) && registration.outboundOffset == registration.outbound.size()) {
+                    mWritable->push_back(sock);
+                }
+                if(mFaulty != nullptr && (events & (EPOLLPRI | EPOLLERR))) {
+                    mFaulty->push_back(sock);
+                }
+            }
+
+            // Serve the sockets of the ready list, which did not get an event in this turn.
+            void serveReady() {
+                for(auto& i : mServing) {
+                    Registration** found = mRegistrations.find(i);
+
+                    if(found == nullptr || (*found)->readyTurn != mTurn) { //removed, or already served by an event
+                        continue;
+                    }
+
+                    (*found)->readyTurn = 0;
+                    if((*found)->awaited || (*found)->callbacks) {
+                        call(**found, EPOLLIN);
+                    }
+                    else {
+                        report(**found, EPOLLIN);
+                    }
+                }
+                mServing.clear();
+            }
+
+            // Switch a socket to the waiters, and store one.
+            bool await(Socket& sock, SelectorTask& waiter, const bool& write) noexcept {
+                Registration** found = mRegistrations.find(sock.getSocket());
+
+                if(found == nullptr) {
+                    return false;
+                }
+
+                Registration& registration = **found;
+                if(!registration.awaited) {
+                    epoll_event event;
+
+                    if(!registration.callbacks) {
+                        mHandled++;
+                    }
+                    registration.awaited = true;
+                    registration.writeWatched = true;
+                    event.events = getInterest(registration);
+                    event.data.u64 = mRegistrations.getHandle(sock.getSocket());
+
+                    mSyscalls++;
+                    if(epoll_ctl(mEpoll, EPOLL_CTL_MOD, sock.getSocket(), &event) == -1) {
+                        gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not modify a socket.");
+                    }
+                }
+
+                (write ? registration.writeWaiter : registration.readWaiter) = std::move(waiter);
+                return true;
+            }
+
+            // Watch EPOLLOUT only if the interest has changed.
+            void updateWriteInterest(Registration& registration) noexcept {
+                epoll_event event;
+                event.events = getInterest(registration);
+
+                if(((event.events & EPOLLOUT) != 0) == registration.writeWatched) {
+                    return;
+                }
+
+                int fd = registration.socket.get()->getSocket();
+                event.data.u64 = mRegistrations.getHandle(fd);
+                registration.writeWatched = !registration.writeWatched;
+
+                mSyscalls++;
+                if(epoll_ctl(mEpoll, EPOLL_CTL_MOD, fd, &event) == -1) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not modify a socket.");
+                }
+            }
+
+            // Send as much of the outbound queue as the kernel takes. On error the socket error
+            // callback is called, which can remove the socket, so the registration can not be used after false.
+            bool flush(Registration& registration) noexcept {
+                Socket& sock = *registration.socket.get();
+
+                while(registration.outboundOffset < registration.outbound.size()) {
+                    mSyscalls++;
+                    ssize_t sent = ::send(sock.getSocket(), registration.outbound.data() + registration.outboundOffset,
+                        registration.outbound.size() - registration.outboundOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+                    if(sent >= 0) {
+                        registration.outboundOffset += sent;
+                    }
+                    else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    else if(errno != EINTR) {
+                        gSocketErrorFunction(sock, ERROR_SOCKET_SEND, errno);
+                        return false;
+                    }
+                }
+
+                if(registration.outboundOffset == registration.outbound.size()) {
+                    registration.outbound.clear(); //the capacity stays
+                    registration.outboundOffset = 0;
+                }
+                else if(registration.outboundOffset >= registration.outbound.size() / 2) { //do not let the sent part grow
+                    registration.outbound.erase(0, registration.outboundOffset);
+                    registration.outboundOffset = 0;
+                }
+
+                updateWriteInterest(registration);
+                return true;
+            }
+
+            // Poll without waiting until an event or a task arrives, or the spin budget is used up.
+            // A positive timeout cuts the spin, and the spent time is subtracted from it.
+            int spin(int& timeout) noexcept {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                std::chrono::steady_clock::time_point end = start + mSpinBudget;
+                int readyCount = 0;
+
+                if(timeout > 0 && start + std::chrono::milliseconds(timeout) < end) {
+                    end = start + std::chrono::milliseconds(timeout);
+                }
+
+                do {
+                    mSyscalls++;
+                    if((readyCount = epoll_wait(mEpoll, mEvents.data(), mEvents.size(), 0)) != 0 || !mMailbox->tasks.isEmpty()) {
+                        break;
+                    }
+                } while(std::chrono::steady_clock::now() < end);
+
+                if(timeout > 0) {
+                    int spent = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                    timeout = std::max(0, timeout - spent);
+                }
+                return readyCount;
+            }
+
+            // Apply the busy poll options to a socket.
+            void applyBusyPoll(Socket& sock) noexcept {
+                sock.setSocketOption(SO_BUSY_POLL, mBusyPoll);
+                sock.setSocketOption(SO_PREFER_BUSY_POLL, mBusyPoll > 0 && mPreferBusyPoll ? 1 : 0);
+            }
+
+            // Apply the options of the selector to a new socket.
+            void applyOptions(Socket& sock) noexcept {
+                if(mBusyPoll > 0) {
+                    applyBusyPoll(sock);
+                }
+            }
+
+            // Nanoseconds between two time points.
+            static uint64_t getNanoseconds(const std::chrono::steady_clock::time_point& start, const std::chrono::steady_clock::time_point& end) noexcept {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            }
+
+            // Count an iteration after its wait.
+            void recordWait(const std::chrono::steady_clock::time_point& waitStart, const int& readyCount) noexcept {
+                LoopStats& stats = mMailbox->stats;
+
+                mWaitEnd = std::chrono::steady_clock::now();
+                stats.iterations.store(stats.iterations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                stats.waitTime.record(getNanoseconds(waitStart, mWaitEnd));
+                stats.readyCount.record(readyCount > 0 ? readyCount : 0);
+                stats.syscalls.record(mSyscalls);
+                mSyscalls = 0;
+            }
+
+            // Call the posted tasks.
+            void runTasks() {
+                SelectorTask task;
+
+                while(mMailbox->tasks.pop(task)) {
+                    task();
+                }
+                task = nullptr;
+            }
+
+            // Convert the stored timeout to milliseconds, rounded up. -1 means no timeout.
+            int getTimeoutMilliseconds() const noexcept {
+                if(mTimeout.tv_sec < 0) {
+                    return -1;
+                }
+                return mTimeout.tv_sec * 1000 + (mTimeout.tv_usec + 999) / 1000;
+            }
+
+            // Milliseconds since the construction, the time of the timers.
+            uint64_t getTick() const noexcept {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - mTimerStart).count();
+            }
+
+            int mEpoll; //epoll instance
+            // State shared with the other threads.
+            struct Mailbox {
+                MpscQueue<SelectorTask> tasks; //of post()
+                std::atomic<bool> sleeping; //update() waits in the kernel
+                std::atomic<bool> woken; //mWake was written and not read yet
+                LoopStats stats; //of getStats(), written only by the loop
+
+                Mailbox() : sleeping(false), woken(false) {}
+            };
+
+            int mWake; //eventfd for wakeup(), registered with handle 0
+            std::unique_ptr<Mailbox> mMailbox; //it does not move with the selector
+            SocketTable<Registration*> mRegistrations; //all sockets, the handles are stored in the kernel
+            ObjectPool<Registration> mPool; //memory of the registrations, reused after remove()
+            std::vector<Registration*> mRemoved; //removed by the handlers, freed after the dispatch
+            size_t mHandled; //number of sockets with handlers
+            bool mDispatching; //update() calls the handlers
+            std::atomic<bool> mStopped; //set by stop(), cleared when run() returns
+            std::vector<Socket*>* mWritable, *mReadable, *mFaulty; //pointers to user provided arrays
+            std::vector<epoll_event> mEvents; //events returned by the kernel, grows if it was filled
+            timeval mTimeout; //this store the selector timeout
+            bool mEdgeTriggered; //report only the changes of the state
+            std::chrono::microseconds mSpinBudget; //polling time before a blocking wait
+            int mBusyPoll; //SO_BUSY_POLL of the sockets in microseconds, 0 if it is not set
+            bool mPreferBusyPoll; //SO_PREFER_BUSY_POLL of the sockets
+            TimerWheel mTimers; //timers of addTimer()
+            std::chrono::steady_clock::time_point mTimerStart; //tick 0 of mTimers
+            bool mStatsEnabled; //the times are measured
+            uint64_t mSyscalls; //system calls since the last wait
+            std::chrono::steady_clock::time_point mWaitEnd; //the end of the last wait, 0 if it was not measured
+            ReadBudget mReadBudget; //of getReadBudget()
+            std::vector<SocketHandle> mReady; //requeued sockets, served in the next turn
+            std::vector<SocketHandle> mServing; //the ready list of the current turn
+            uint64_t mTurn; //number of the dispatches
+
+        protected:
+
+        public:
+            /*! \fn EpollSelector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty)
+                \brief Constructor. If the epoll instance could not be created,
+                    the common error callback is called with ERROR_SELECTOR_CREATE.
+                \param readable Array for the pointers of the readable sockets.
+                \param writable Array for the pointers of the sockets whose send() queue is drained, see setWritable().
+                \param faulty Array for the pointers to the sockets which got exception.*/
+            EpollSelector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty) noexcept :
+                mEpoll(-1),
+                mWake(-1),
+                mMailbox(new Mailbox()),
+                mHandled(0),
+                mDispatching(false),
+                mStopped(false),
+                mWritable(writable),
+                mReadable(readable),
+                mFaulty(faulty),
+                mEvents(64),
+                mEdgeTriggered(false),
+                mSpinBudget(0),
+                mBusyPoll(0),
+                mPreferBusyPoll(false),
+                mTimerStart(std::chrono::steady_clock::now()),
+                mStatsEnabled(false),
+                mSyscalls(0),
+                mReadBudget{0, 0},
+                mTurn(0)
+            {
+                mTimeout.tv_sec = 0;
+                mTimeout.tv_usec = 0;
+
+                if((mEpoll = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CREATE, "Selector could not be created.");
+                    return;
+                }
+
+                epoll_event event;
+                event.events = EPOLLIN;
+                event.data.u64 = 0;
+
+                if((mWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1 || epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWake, &event) == -1) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CREATE, "Selector could not be created.");
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy methods deleted. Moving methods are available.*/
+            EpollSelector(const EpollSelector& other) = delete;
+            EpollSelector& operator=(const EpollSelector& other) = delete;
+
+            EpollSelector(EpollSelector&& other) noexcept :
+                mEpoll(other.mEpoll),
+                mWake(other.mWake),
+                mMailbox(std::move(other.mMailbox)),
+                mRegistrations(std::move(other.mRegistrations)),
+                mPool(std::move(other.mPool)),
+                mRemoved(std::move(other.mRemoved)),
+                mHandled(other.mHandled),
+                mDispatching(false),
+                mStopped(other.mStopped.load()),
+                mWritable(other.mWritable),
+                mReadable(other.mReadable),
+                mFaulty(other.mFaulty),
+                mEvents(std::move(other.mEvents)),
+                mTimeout(other.mTimeout),
+                mEdgeTriggered(other.mEdgeTriggered),
+                mSpinBudget(other.mSpinBudget),
+                mBusyPoll(other.mBusyPoll),
+                mPreferBusyPoll(other.mPreferBusyPoll),
+                mTimers(std::move(other.mTimers)),
+                mTimerStart(other.mTimerStart),
+                mStatsEnabled(other.mStatsEnabled),
+                mSyscalls(other.mSyscalls),
+                mWaitEnd(other.mWaitEnd),
+                mReadBudget(other.mReadBudget),
+                mReady(std::move(other.mReady)),
+                mServing(std::move(other.mServing)),
+                mTurn(other.mTurn)
+            {
+                other.mEpoll = -1;
+                other.mWake = -1;
+                other.mMailbox.reset(new Mailbox());
+                other.mRegistrations.clear();
+                other.mRemoved.clear();
+                other.mServing.clear();
+                other.mHandled = 0;
+                other.mWritable = nullptr;
+                other.mReadable = nullptr;
+                other.mFaulty = nullptr;
+            }
+
+            EpollSelector& operator=(EpollSelector&& other) noexcept {
+                std::swap(mEpoll, other.mEpoll);
+                std::swap(mWake, other.mWake);
+                std::swap(mMailbox, other.mMailbox);
+                std::swap(mRegistrations, other.mRegistrations);
+                std::swap(mPool, other.mPool);
+                std::swap(mRemoved, other.mRemoved);
+                std::swap(mHandled, other.mHandled);
+
+                bool stopped = mStopped.load();
+                mStopped.store(other.mStopped.load());
+                other.mStopped.store(stopped);
+
+                std::swap(mWritable, other.mWritable);
+                std::swap(mReadable, other.mReadable);
+                std::swap(mFaulty, other.mFaulty);
+                std::swap(mEvents, other.mEvents);
+                std::swap(mTimeout, other.mTimeout);
+                std::swap(mEdgeTriggered, other.mEdgeTriggered);
+                std::swap(mSpinBudget, other.mSpinBudget);
+                std::swap(mBusyPoll, other.mBusyPoll);
+                std::swap(mPreferBusyPoll, other.mPreferBusyPoll);
+                std::swap(mTimers, other.mTimers);
+                std::swap(mTimerStart, other.mTimerStart);
+                std::swap(mStatsEnabled, other.mStatsEnabled);
+                std::swap(mSyscalls, other.mSyscalls);
+                std::swap(mWaitEnd, other.mWaitEnd);
+                std::swap(mReadBudget, other.mReadBudget);
+                std::swap(mReady, other.mReady);
+                std::swap(mServing, other.mServing);
+                std::swap(mTurn, other.mTurn);
+                return *this;
+            }
+
+            /*! \fn void swap(EpollSelector& other)
+                \brief Swap the references between two EpollSelector
+                \param other Another EpollSelector*/
+            void swap(EpollSelector& other) noexcept {
+                EpollSelector temp = std::move(*this);
+                *this = std::move(other);
+                other = std::move(temp);
+            }
+
+            /*! \fn ~EpollSelector()
+                \brief Destructor. All sockets will be unwatched and destroyed if it is necessary.
+                    The waiters of the sockets and the posted tasks are called before, so the
+                    suspended coroutines find out that their sockets are removed, and finish.*/
+            ~EpollSelector() {
+                do {
+                    removeAll(); //posts the waiters
+                    runTasks(); //they can add sockets again
+                } while(!mRegistrations.isEmpty());
+
+                if(mWake != -1) {
+                    close(mWake);
+                }
+                if(mEpoll != -1) {
+                    close(mEpoll);
+                }
+            }
+
+            /*! \fn void update()
+                \brief Call the expired timers and the posted tasks, wait for events, fill the user provided
+                    arrays with the ready sockets and call the handlers. The wait is not longer than the time
+                    until the nearest timer. If the selector failed, errno set to indicate the error.*/
+            void update() {
+                if(mReadable == nullptr && mWritable == nullptr && mFaulty == nullptr && mTimers.isEmpty() && mHandled == 0 && mMailbox->tasks.isEmpty()) {
+                    gCommonErrorFunction(ERROR_SELECTOR_NO_TARGET, "Selector does not have target.");
+                    return;
+                }
+
+                clearTemp();
+
+                uint64_t now = getTick();
+                mTimers.advance(now);
+                runTasks();
+
+                int timeout = getTimeoutMilliseconds();
+                bool timerBound = false; //the wait is cut by a timer or a spin, an empty one is not a timeout
+                uint64_t nextTick = mTimers.getNextTick();
+
+                if(nextTick != std::numeric_limits<uint64_t>::max()) {
+                    uint64_t untilTimer = nextTick > now ? nextTick - now : 0;
+
+                    if(timeout < 0 || untilTimer < (uint64_t) timeout) {
+                        timeout = untilTimer;
+                        timerBound = true;
+                    }
+                }
+                if(!mReady.empty()) { //the ready list is served without waiting
+                    timeout = 0;
+                    timerBound = true;
+                }
+
+                std::chrono::steady_clock::time_point waitStart;
+                if(mStatsEnabled) {
+                    waitStart = std::chrono::steady_clock::now();
+
+                    if(mWaitEnd.time_since_epoch().count() != 0) {
+                        mMailbox->stats.busyTime.record(getNanoseconds(mWaitEnd, waitStart));
+                    }
+                }
+
+                int readyCount = 0;
+                if(mSpinBudget.count() > 0 && (timeout != 0 || !timerBound)) { //not when a timer or the ready list is due
+                    if(timeout == 0) { //a spinning loop, it spins for the whole budget
+                        timerBound = true;
+                    }
+                    readyCount = spin(timeout);
+                }
+
+                if(readyCount == 0) {
+                    mMailbox->sleeping.store(true, std::memory_order_seq_cst);
+                    if(!mMailbox->tasks.isEmpty()) { //posted before post() could see the sleeping flag
+                        timeout = 0;
+                        timerBound = true;
+                    }
+
+                    readyCount = epoll_wait(mEpoll, mEvents.data(), mEvents.size(), timeout);
+                    mMailbox->sleeping.store(false, std::memory_order_relaxed);
+                    mSyscalls++;
+                }
+
+                if(mStatsEnabled) {
+                    recordWait(waitStart, readyCount);
+                }
+
+                if(readyCount < 0 || (readyCount == 0 && mReady.empty())) {
+                    if(readyCount == 0) {
+                        mTimers.advance(getTick());
+                        runTasks();
+
+                        if(!timerBound) {
+                            gCommonErrorFunction(ERROR_SELECTOR_TIMEOUT, "Selector timed out.");
+                        }
+                        return;
+                    }
+                    else {
+                        gCommonErrorFunction(ERROR_SELECTOR_FAIL, "Selector error.");
+                        return;
+                    }
+                }
+
+                runTasks();
+                mDispatching = true;
+                mTurn++;
+                mServing.swap(mReady); //requeued from now on are served in the next turn
+
+                for(int i = 0; i < readyCount; i++) {
+                    uint32_t events = mEvents[i].events;
+                    SocketHandle handle = mEvents[i].data.u64;
+
+                    if(handle == 0) { //woken up by wakeup() or post()
+                        uint64_t counter;
+                        mMailbox->woken.store(false, std::memory_order_relaxed);
+                        while(read(mWake, &counter, sizeof(counter)) == -1 && errno == EINTR) {}
+                        mSyscalls++;
+                        continue;
+                    }
+
+                    Registration** found = mRegistrations.find(handle);
+                    if(found == nullptr) { //removed by a handler of an earlier event
+                        continue;
+                    }
+
+                    Registration* registration = *found;
+                    if(registration->readyTurn == mTurn) { //it is served now, not from the ready list
+                        registration->readyTurn = 0;
+                        events |= EPOLLIN;
+                    }
+                    if((events & (EPOLLOUT | EPOLLERR)) && registration->outboundOffset < registration->outbound.size()) {
+                        if(!flush(*registration) && (found = mRegistrations.find(handle)) == nullptr) { //removed by the error callback
+                            continue;
+                        }
+                    }
+                    if(registration->awaited || registration->callbacks) {
+                        call(*registration, events);
+                    }
+                    else {
+                        report(*registration, events);
+                    }
+                }
+
+                serveReady();
+                mDispatching = false;
+                collect();
+
+                if(readyCount == (int) mEvents.size()) { //there could be more ready sockets, make room for them
+                    mEvents.resize(mEvents.size() * 2);
+                }
+            }
+
+            /*! \fn void run()
+                \brief Calls update() until stop() is called. If stop() was called before, it returns at once.
+                    Use it with handlers and timers, the arrays are cleared in every update().*/
+            void run() {
+                while(!mStopped.load(std::memory_order_acquire)) {
+                    update();
+                }
+                mStopped.store(false, std::memory_order_relaxed);
+            }
+
+            /*! \fn void stop()
+                \brief Makes run() return after the current update(). It can be called from any thread.*/
+            void stop() noexcept {
+                mStopped.store(true, std::memory_order_release);
+                wakeup();
+            }
+
+            /*! \fn void add(const socketType& sock)
+                \brief Adds a socket to the EpollSelector. The socket is registered in the
+                    kernel here, and stay registered until it is removed. It is copied into
+                    a pooled registration, so it does not allocate when a socket was removed before.
+
+                You can use it without the template parameter:
+                \code
+                ClientSocket client(Address("127.0.0.1"));
+                selector.add(client);
+                \endcode
+                \param sock The socket which will be stored.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType& sock) noexcept {
+                Registration* registration = insert(sock.getSocket(), nullptr);
+
+                if(registration != nullptr) {
+                    registration->socket.store<SocketType>(sock);
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn void add(socketType&& sock)
+                \brief Adds a socket by moving it in, so the reference counter
+                    of the file descriptor is not changed:
+                \code
+                selector.add(listener.accept());
+                \endcode
+                \param sock The socket which will be stored.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType&& sock) noexcept {
+                Registration* registration = insert(sock.getSocket(), nullptr);
+
+                if(registration != nullptr) {
+                    registration->socket.store<SocketType>(std::move(sock));
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn void watch(Socket& sock)
+                \brief Adds a socket without storing a copy. The reported pointers point to sock.
+                \param sock It has to live until it is removed from the EpollSelector.*/
+            void watch(Socket& sock) noexcept {
+                Registration* registration = insert(sock.getSocket(), nullptr);
+
+                if(registration != nullptr) {
+                    registration->socket.watch(sock);
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn void add(const socketType& sock, const SocketHandlers& handlers)
+                \brief Adds a socket with its own handlers. They are called by update()
+                    with the stored copy of the socket, which can be cast back to SocketType.
+                    The socket is not put into the arrays.
+
+                    Only the events with a handler are watched: onReadable with EPOLLIN
+                    and onClosed with EPOLLRDHUP. onWritable is called once when the socket becomes
+                    writable, and after every send() which could not be sent at once, when the
+                    queue is empty again, so EPOLLOUT is not watched all the time. Hang up and errors
+                    are passed to onReadable and onClosed. A handler can add and remove any socket,
+                    even its own, the removed sockets are destroyed after the dispatch.
+
+                    The handlers are copied. A std::function does not allocate memory
+                    if its lambda captures only a pointer, for example [this].
+                \param sock The socket which will be stored.
+                \param handlers The empty handlers are not called.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType& sock, const SocketHandlers& handlers) noexcept {
+                Registration* registration = insert(sock.getSocket(), &handlers);
+
+                if(registration != nullptr) {
+                    registration->socket.store<SocketType>(sock);
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn void add(socketType&& sock, const SocketHandlers& handlers)
+                \brief Adds a socket with its own handlers by moving it in.
+                \param sock The socket which will be stored.
+                \param handlers The empty handlers are not called.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType&& sock, const SocketHandlers& handlers) noexcept {
+                Registration* registration = insert(sock.getSocket(), &handlers);
+
+                if(registration != nullptr) {
+                    registration->socket.store<SocketType>(std::move(sock));
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn void watch(Socket& sock, const SocketHandlers& handlers)
+                \brief Adds a socket with its own handlers without storing a copy.
+                    The handlers get sock.
+                \param sock It has to live until it is removed from the EpollSelector.
+                \param handlers The empty handlers are not called.*/
+            void watch(Socket& sock, const SocketHandlers& handlers) noexcept {
+                Registration* registration = insert(sock.getSocket(), &handlers);
+
+                if(registration != nullptr) {
+                    registration->socket.watch(sock);
+                    applyOptions(*registration->socket.get());
+                }
+            }
+
+            /*! \fn bool send(Socket& sock, const Packet& packet)
+                \brief Sends a packet on a stored stream socket without blocking. What the kernel does not
+                    take at once is queued, and sent by update() when the socket becomes writable.
+                    EPOLLOUT is watched only while the queue is not empty. The packets keep their order.
+                    On error the socket error callback is called with ERROR_SOCKET_SEND.
+                \param sock A socket of the EpollSelector.
+                \param packet
+                \return false if the socket is not stored or the sending failed*/
+            bool send(Socket& sock, const Packet& packet) noexcept {
+                Registration** found = mRegistrations.find(sock.getSocket());
+
+                if(found == nullptr) {
+                    return false;
+                }
+
+                Registration& registration = **found;
+                bool idle = registration.outboundOffset == registration.outbound.size();
+
+                packet.serialize(registration.outbound);
+                if(idle && !flush(registration)) {
+                    return false;
+                }
+
+                if(registration.callbacks && registration.handlers.onWritable
+                        && registration.outboundOffset < registration.outbound.size()) { //called when it is drained
+                    registration.writeWanted = true;
+                }
+                return true;
+            }
+
+            /*! \fn bool requeue(Socket& sock)
+                \brief Puts a socket to the ready list, which is served round-robin: in the next update()
+                    the socket is reported as readable again (its onReadable or read waiter is called,
+                    or it is put into the readable array), even if the kernel does not report it.
+                    update() does not wait while the list is not empty. Call it from a handler which
+                    stopped reading because the read budget was used up:
+                    \code
+                    selector.add(client, tnnf::SocketHandlers{[&](tnnf::Socket& sock) {
+                        bool more = false;
+
+                        if(!sock.drain(buffer, selector.getReadBudget(), more)) {
+                            selector.remove(sock);
+                            return;
+                        }
+                        if(more) {
+                            selector.requeue(sock); //the others come first
+                        }
+                    }});
+                    \endcode
+                    A socket is in the list only once, and it is served only once in a turn, even
+                    if it gets an event too.
+                \param sock A socket of the EpollSelector.
+                \return false if the socket is not stored*/
+            bool requeue(Socket& sock) {
+                Registration** found = mRegistrations.find(sock.getSocket());
+
+                if(found == nullptr) {
+                    return false;
+                }
+                if((*found)->readyTurn != mTurn + 1) {
+                    (*found)->readyTurn = mTurn + 1;
+                    mReady.push_back(mRegistrations.getHandle(sock.getSocket()));
+                }
+                return true;
+            }
+
+            /*! \fn void setReadBudget(const ReadBudget& budget)
+                \brief Sets how much a socket may read in one turn of the loop. The selector does not
+                    read, the handlers pass getReadBudget() to Socket::drain(), and requeue() the socket
+                    if there is more. So one busy peer can not hold up the update() for the others.
+                \param budget The limits, 0 means no limit (default).*/
+            void setReadBudget(const ReadBudget& budget) noexcept {
+                mReadBudget = budget;
+            }
+
+            /*! \fn const ReadBudget& getReadBudget()
+                \return the limits of a socket in one turn*/
+            const ReadBudget& getReadBudget() const noexcept {
+                return mReadBudget;
+            }
+
+            /*! \fn bool waitReadable(Socket& sock, SelectorTask waiter)
+                \brief Calls the waiter once from update(), when the socket becomes readable, or hung up.
+                    It is made for the awaitables of tnnf/Coroutine.hpp.
+
+                    After the first wait the socket is watched edge-triggered for reading and writing
+                    until it is removed, and it is not put into the arrays and its handlers are not
+                    called any more. So only wait after a non-blocking call returned EAGAIN, otherwise
+                    the waiter could wait for an edge which has already passed. If the socket is
+                    removed, the waiters are called by the next update(), and find() does not find it.
+                \param sock A socket of the EpollSelector.
+                \param waiter It replaces the previous waiter, it can wait again.
+                \return false if the socket is not stored*/
+            bool waitReadable(Socket& sock, SelectorTask waiter) noexcept {
+                return await(sock, waiter, false);
+            }
+
+            /*! \fn bool waitWritable(Socket& sock, SelectorTask waiter)
+                \brief Calls the waiter once from update(), when the socket becomes writable, or failed.
+                    See waitReadable().
+                \param sock A socket of the EpollSelector.
+                \param waiter It replaces the previous waiter, it can wait again.
+                \return false if the socket is not stored*/
+            bool waitWritable(Socket& sock, SelectorTask waiter) noexcept {
+                return await(sock, waiter, true);
+            }
+
+            /*! \fn size_t getPendingSize(Socket& sock)
+                \brief It can be used for flow control, to stop reading a peer which does not read.
+                \param sock A socket of the EpollSelector.
+                \return the number of queued bytes of send(), which are not sent yet*/
+            size_t getPendingSize(Socket& sock) noexcept {
+                Registration** found = mRegistrations.find(sock.getSocket());
+                return found == nullptr ? 0 : (*found)->outbound.size() - (*found)->outboundOffset;
+            }
+
+            /*! \fn void remove(Socket& sock)
+                \brief Removes a socket. If the socket does not have more reference, it will be destroyed.
+                    The queued packets of send() are dropped. A handler can call it for its own socket too.
+                \param sock The socket which will be removed.*/
+            void remove(Socket& sock) noexcept {
+                if(mRegistrations.find(sock.getSocket()) != nullptr) {
+                    release(sock.getSocket());
+                }
+            }
+
+            /*! \fn void removeAll()
+                \brief Removes all socket from the selector.*/
+            void removeAll() noexcept {
+                clearTemp();
+
+                while(!mRegistrations.isEmpty()) {
+                    release(mRegistrations.getDescriptors().back());
+                }
+            }
+
+            /*! \fn void setWritable(std::vector<Socket*>* array)
+                \brief You can specify the array where the references to writable sockets will be stored.
+                    EPOLLOUT is not watched for every socket, it would be reported in every update():
+                    a socket is put into the array when the queue of its send() calls is drained.
+                    Send with send() and check getPendingSize() for flow control, and use waitWritable()
+                    for a connecting socket.
+                \param array*/
+            void setWritable(std::vector<Socket*>* array) noexcept {
+                mWritable = array;
+            }
+
+            /*! \fn void setReadable(std::vector<Socket*>* array)
+                \brief You can specify the array where the references to readable sockets will be stored.
+                    Every registered socket is modified in the kernel, so do not call it in every loop.
+                \param array*/
+            void setReadable(std::vector<Socket*>* array) noexcept {
+                mReadable = array;
+                updateInterest();
+            }
+
+            /*! \fn void setFaulty(std::vector<Socket*>* array)
+                \brief You can specify the array where the references will be stored to
+                that sockets which got exceptions.
+                    Every registered socket is modified in the kernel, so do not call it in every loop.
+                \param array*/
+            void setFaulty(std::vector<Socket*>* array) noexcept {
+                mFaulty = array;
+                updateInterest();
+            }
+
+            /*! \fn void setSpinBudget(const unsigned int& microseconds)
+                \brief Before every blocking wait, update() polls the kernel without waiting until an event
+                    or a posted task arrives, or the budget is used up. It saves the wakeup latency
+                    of the thread for the price of a busy CPU core. The empty polls are not reported.
+                    With the default timeout of 0, update() spins for the budget, and if nothing arrived,
+                    it returns without reporting ERROR_SELECTOR_TIMEOUT, so it can be called in a loop.
+                    With a longer timeout, it spins for at most the budget, then it blocks for the rest of
+                    the timeout, and the timeout is reported only if the whole timeout has elapsed.
+                \param microseconds 0 switches it off (default).*/
+            void setSpinBudget(const unsigned int& microseconds) noexcept {
+                mSpinBudget = std::chrono::microseconds(microseconds);
+            }
+
+            /*! \fn void setBusyPoll(const int& microseconds, const bool& prefer = true)
+                \brief Sets SO_BUSY_POLL (and SO_PREFER_BUSY_POLL) on every registered socket and on
+                    the sockets added later, so the kernel polls the network device instead of
+                    waiting for an interrupt. Use it with setSpinBudget(). Raising it over
+                    net.core.busy_read needs CAP_NET_ADMIN, errors are reported
+                    with ERROR_SOCKET_SETSOCKOPT.
+                \param microseconds Busy poll time of a receive, 0 switches it off.
+                \param prefer Sets SO_PREFER_BUSY_POLL, the device interrupts are deferred while the loop polls.*/
+            void setBusyPoll(const int& microseconds, const bool& prefer = true) noexcept {
+                mBusyPoll = microseconds;
+                mPreferBusyPoll = prefer;
+
+                for(auto& i : mRegistrations.getDescriptors()) {
+                    applyBusyPoll(*(*mRegistrations.find(i))->socket.get());
+                }
+            }
+
+            /*! \fn void setStatsEnabled(const bool& enabled)
+                \brief Switches the measuring of getStats() on or off (default). It costs some
+                    clock reads in every update() and around the handlers of every socket.
+                \param enabled*/
+            void setStatsEnabled(const bool& enabled) noexcept {
+                mStatsEnabled = enabled;
+                mWaitEnd = std::chrono::steady_clock::time_point();
+                mSyscalls = 0;
+            }
+
+            /*! \fn const LoopStats& getStats()
+                \brief The statistics of the loop, collected while setStatsEnabled() is on.
+                    They can be read from any thread while the loop runs, for example:
+                    \code
+                    const tnnf::LoopStats& stats = reactor.getSelector().getStats();
+
+                    std::cout << "p99 loop lag: " << stats.busyTime.getPercentile(99) / 1000 << " us, "
+                        << "ready per wakeup: " << stats.readyCount.getMean() << std::endl;
+                    \endcode
+                \return the statistics, they stay at their place when the selector is moved*/
+            const LoopStats& getStats() const noexcept {
+                return mMailbox->stats;
+            }
+
+            /*! \fn void setEdgeTriggered(const bool& edgeTriggered)
+                \brief Switch between level-triggered (default) and edge-triggered mode.
+
+                    In edge-triggered mode a socket is reported only once when new data arrives,
+                    so you have to read everything with drain() instead of receive(),
+                    otherwise the remaining data will not be reported again:
+                    \code
+                    for(auto& sock : readableSockets) {
+                        sock->drain(buffer);
+
+                        while(buffer.isPacketStored()) {
+                            tnnf::Packet receivedPacket = buffer.getPacket();
+                        }
+                    }
+                    \endcode
+                    For the same reason a ListenerSocket has to accept every waiting connection.
+                    Every registered socket is modified in the kernel, so do not call it in every loop.
+                \param edgeTriggered true for edge-triggered mode*/
+            void setEdgeTriggered(const bool& edgeTriggered) noexcept {
+                mEdgeTriggered = edgeTriggered;
+                updateInterest();
+            }
+
+            /*! \fn TimerId addTimer(const uint64_t& milliseconds, const TimerCallback& callback, const uint64_t& interval = 0)
+                \brief Adds a timer, which is called from update(). Adding and cancelling is constant time.
+                \param milliseconds The time until the timer expires.
+                \param callback It can add and cancel timers, and remove sockets.
+                \param interval If it is not 0, the timer will be called again in every interval milliseconds,
+                    until it is cancelled.
+                \return the id of the timer for cancelTimer()*/
+            TimerId addTimer(const uint64_t& milliseconds, const TimerCallback& callback, const uint64_t& interval = 0) {
+                return mTimers.add(getTick() + milliseconds, callback, interval);
+            }
+
+            /*! \fn bool cancelTimer(const TimerId& id)
+                \brief Cancels a timer. It is harmless to cancel an expired timer.
+                \param id The id returned by addTimer().
+                \return true if the timer was active*/
+            bool cancelTimer(const TimerId& id) noexcept {
+                return mTimers.cancel(id);
+            }
+
+            /*! \fn void wakeup()
+                \brief Makes the running or the next update() return, even if there is no event.
+                    It can be called from any thread. The eventfd is not written again until
+                    the loop has read it.*/
+            void wakeup() noexcept {
+                if(mMailbox->woken.exchange(true, std::memory_order_acq_rel)) {
+                    return;
+                }
+
+                uint64_t counter = 1;
+                while(write(mWake, &counter, sizeof(counter)) == -1 && errno == EINTR) {}
+            }
+
+            /*! \fn void post(SelectorTask task)
+                \brief Hands a task over to the thread of the loop without a lock. It can be called
+                    from any thread. The task is called by update(), before the events are dispatched.
+                    If the loop is not waiting in the kernel, it costs one atomic exchange,
+                    otherwise the loop is woken up.
+                \param task It can use every method of the EpollSelector.*/
+            void post(SelectorTask task) {
+                mMailbox->tasks.push(std::move(task));
+
+                if(mMailbox->sleeping.load(std::memory_order_seq_cst)) {
+                    wakeup();
+                }
+            }
+
+            /*! \fn void setTimeout(const timeval& timeout)
+                \brief Set timeout for update() method. It is rounded up to milliseconds.
+                    With negative seconds update() waits until an event arrives.
+                \param timeout A reference to a timeval variable which will be copied.*/
+            void setTimeout(const timeval& timeout) noexcept {
+                mTimeout = timeout;
+            }
+
+            /*! \fn void setTimeout(const int& sec, const int& usec)
+                \brief Set timeout for update() method. It is rounded up to milliseconds.
+                    With negative seconds update() waits until an event arrives.
+                \param sec Seconds.
+                \param usec Microseconds.*/
+            void setTimeout(const int& sec, const int& usec) noexcept {
+                mTimeout.tv_sec = sec;
+                mTimeout.tv_usec = usec;
+            }
+
+            /*! \fn std::vector<Socket*> getAll()
+                \brief Get all stored sockets.
+                \return The array which contains the references to the sockets.*/
+            std::vector<Socket*> getAll() noexcept {
+                std::vector<Socket*> sockets;
+                sockets.reserve(mRegistrations.getSize());
+
+                for(auto& i : mRegistrations.getDescriptors()) {
+                    sockets.push_back((*mRegistrations.find(i))->socket.get());
+                }
+                return sockets;
+            }
+
+            /*! \fn SocketHandle getHandle(Socket& sock)
+                \brief A handle identifies a socket of the EpollSelector without a pointer, so it
+                    can be kept after the socket is removed. It does not find a later socket,
+                    which got the same file descriptor.
+                \param sock A stored socket.
+                \return the handle, 0 if the socket is not stored*/
+            SocketHandle getHandle(Socket& sock) const noexcept {
+                return mRegistrations.getHandle(sock.getSocket());
+            }
+
+            /*! \fn Socket* find(const SocketHandle& handle)
+                \brief Finds a stored socket in constant time.
+                \param handle The result of getHandle().
+                \return the stored socket, nullptr if it was removed*/
+            Socket* find(const SocketHandle& handle) noexcept {
+                Registration** found = mRegistrations.find(handle);
+                return found == nullptr ? nullptr : (*found)->socket.get();
+            }
+    };
+}//tnnf
+
+#endif
@@ -0,0 +1,471 @@
+/*! \file Handover.hpp
+    \brief Handing listeners and connections over to a new process through a Unix socket.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_HANDOVER_HPP
+#define TNNF_HANDOVER_HPP
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ListenerSocket.hpp"
+#include "Packet.hpp"
+#include "PacketBuffer.hpp"
+#include "TcpSocket.hpp"
+#include "tnnf.hpp"
+
+namespace tnnf {
+    // Kinds of the handed over items.
+    const uint32_t HANDOVER_LISTENER = 0;
+    const uint32_t HANDOVER_CONNECTION = 1;
+    const uint32_t HANDOVER_END = 2;
+
+    // Header of an item, in network byte order. The descriptor is attached to it,
+    // and the pending bytes of the connection follow it.
+    struct HandoverHeader {
+        uint32_t kind;
+        uint32_t length;
+    };
+
+    // Fill the address of a Unix socket, false if the path is too long.
+    inline bool MakeHandoverAddress(const std::string& path, sockaddr_un& address) noexcept {
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+
+        if(path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    // Write everything, false on error.
+    inline bool WriteHandover(const int& sock, const char* data, size_t length) noexcept {
+        while(length > 0) {
+            ssize_t sent = ::send(sock, data, length, MSG_NOSIGNAL);
+
+            if(sent == -1) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+    // True if the peer of a Unix socket runs as the same user.
+    inline bool IsHandoverPeerTrusted(const int& sock) noexcept {
+        ucred credentials;
+        socklen_t length = sizeof(credentials);
+
+        return ::getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0
+            && credentials.uid == ::geteuid();
+    }
+
+    // Read exactly length bytes, false on error or hang up.
+    inline bool ReadHandover(const int& sock, char* data, size_t length) noexcept {
+        while(length > 0) {
+            ssize_t received = ::recv(sock, data, length, 0);
+
+            if(received <= 0) {
+                if(received == -1 && errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += received;
+            length -= received;
+        }
+        return true;
+    }
+
+    /*! \class HandoverSender
+        \brief The old process of a restart. It waits on a Unix socket for the new process, and hands
+            its listeners and connections over to it with SCM_RIGHTS, so the listening sockets are
+            never closed and the waiting connections are not dropped.
+
+        Example:
+        \code
+        tnnf::HandoverSender handover("/run/server.handover");
+
+        handover.add(listener);
+        handover.add(client, buffer); //with the bytes of the incomplete packets
+
+        selector.removeAll(); //stop serving
+        if(handover.send()) { //blocks until the new process has taken everything
+            return 0;
+        }
+        \endcode
+        Hand a connection over only after EpollSelector::send() has sent its queue
+        (see EpollSelector::getPendingSize()), the queue is not handed over.
+        Only a process of the same user can connect: the socket file is made with mode 0600,
+        and the credentials of the peer are checked before anything is sent.*/
+    class HandoverSender {
+        private:
+            // A socket to hand over.
+            struct Item {
+                uint32_t kind;
+                TcpSocket socket; //keeps the descriptor open until send()
+                std::string pending; //received bytes, which are not handled yet
+            };
+
+            // Send one item with its descriptor.
+            bool sendItem(const int& sock, Item& item) noexcept {
+                HandoverHeader header = { htonl(item.kind), htonl((uint32_t) item.pending.size()) };
+                char control[CMSG_SPACE(sizeof(int))];
+                iovec vector = { &header, sizeof(header) };
+                msghdr message;
+
+                memset(&message, 0, sizeof(message));
+                memset(control, 0, sizeof(control));
+                message.msg_iov = &vector;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+
+                cmsghdr* descriptor = CMSG_FIRSTHDR(&message);
+                descriptor->cmsg_level = SOL_SOCKET;
+                descriptor->cmsg_type = SCM_RIGHTS;
+                descriptor->cmsg_len = CMSG_LEN(sizeof(int));
+                memcpy(CMSG_DATA(descriptor), &item.socket.getSocket(), sizeof(int));
+
+                ssize_t sent;
+                while((sent = ::sendmsg(sock, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+
+                if(sent == -1) {
+                    return false;
+                }
+                return WriteHandover(sock, ((const char*) &header) + sent, sizeof(header) - sent)
+                    && WriteHandover(sock, item.pending.data(), item.pending.size());
+            }
+
+            std::string mPath; //path of the Unix socket
+            int mSocket; //listening Unix socket
+            std::vector<Item> mItems;
+
+        protected:
+
+        public:
+            /*! \fn HandoverSender(const std::string& path)
+                \brief Constructor. Listens on a Unix socket at path, a former file is removed.
+                    The file is readable and writable only by the owner.
+                    On error the common error callback is called with ERROR_HANDOVER_CREATE.
+                \param path The new process connects to it.*/
+            explicit HandoverSender(const std::string& path) :
+                mPath(path),
+                mSocket(-1)
+            {
+                sockaddr_un address;
+
+                if(!MakeHandoverAddress(path, address)) {
+                    gCommonErrorFunction(ERROR_HANDOVER_CREATE, "Handover path is too long.");
+                    return;
+                }
+
+                ::unlink(path.c_str());
+                if((mSocket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1
+                        || ::fchmod(mSocket, S_IRUSR | S_IWUSR) == -1 //the file gets it at bind(), umask can only clear bits
+                        || ::bind(mSocket, (sockaddr*) &address, sizeof(address)) == -1
+                        || ::listen(mSocket, 1) == -1) {
+                    gCommonErrorFunction(ERROR_HANDOVER_CREATE, "Handover socket could not be created.");
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted.*/
+            HandoverSender(const HandoverSender& other) = delete;
+            HandoverSender& operator=(const HandoverSender& other) = delete;
+            HandoverSender(HandoverSender&& other) = delete;
+            HandoverSender& operator=(HandoverSender&& other) = delete;
+
+            /*! \fn ~HandoverSender()
+                \brief Destructor. Closes and removes the Unix socket.*/
+            ~HandoverSender() {
+                if(mSocket != -1) {
+                    close(mSocket);
+                    ::unlink(mPath.c_str());
+                }
+            }
+
+            /*! \fn void add(ListenerSocket& listener)
+                \brief Hands a listener over. Its waiting connections stay in its queue.
+                \param listener*/
+            void add(ListenerSocket& listener) {
+                mItems.push_back(Item{HANDOVER_LISTENER, listener, std::string()});
+            }
+
+            /*! \fn void add(TcpSocket& sock)
+                \brief Hands a connection over.
+                \param sock*/
+            void add(TcpSocket& sock) {
+                mItems.push_back(Item{HANDOVER_CONNECTION, sock, std::string()});
+            }
+
+            /*! \fn void add(TcpSocket& sock, PacketBuffer& buffer)
+                \brief Hands a connection over with the packets of its buffer, which are not handled yet.
+                    The stored packets are taken out of the buffer.
+                \param sock
+                \param buffer The buffer of the connection.*/
+            void add(TcpSocket& sock, PacketBuffer& buffer) {
+                std::string pending;
+
+                while(buffer.isPacketStored()) {
+                    buffer.getPacket().serialize(pending);
+                }
+                pending.append(buffer.getBuffer(), buffer.getCurrentSize()); //the incomplete packet
+
+                mItems.push_back(Item{HANDOVER_CONNECTION, sock, std::move(pending)});
+            }
+
+            /*! \fn bool send()
+                \brief Waits for the new process, and hands the added sockets over. Call it when the
+                    sockets are not used any more, the new process serves them after it returns true.
+                    A peer of an other user is refused, and it waits for the next one.
+                    On error the common error callback is called with ERROR_HANDOVER_TRANSFER.
+                \return true if the new process has received everything*/
+            bool send() {
+                int sock;
+                char acknowledgement = 0;
+
+                if(mSocket == -1) {
+                    return false;
+                }
+
+                while(true) {
+                    while((sock = ::accept4(mSocket, nullptr, nullptr, SOCK_CLOEXEC)) == -1 && errno == EINTR) {}
+                    if(sock == -1) {
+                        gCommonErrorFunction(ERROR_HANDOVER_TRANSFER, "Handover could not accept the new process.");
+                        return false;
+                    }
+                    if(IsHandoverPeerTrusted(sock)) {
+                        break;
+                    }
+
+                    close(sock);
+                    gCommonErrorFunction(ERROR_HANDOVER_TRANSFER, "Handover refused a process of an other user.");
+                }
+
+                bool success = true;
+                for(auto& i : mItems) {
+                    if(!(success = sendItem(sock, i))) {
+                        break;
+                    }
+                }
+
+                HandoverHeader end = { htonl(HANDOVER_END), 0 };
+                success = success && WriteHandover(sock, (const char*) &end, sizeof(end))
+                    && ReadHandover(sock, &acknowledgement, 1);
+                close(sock);
+
+                if(!success) {
+                    gCommonErrorFunction(ERROR_HANDOVER_TRANSFER, "Handover failed.");
+                    return false;
+                }
+
+                mItems.clear();
+                return true;
+            }
+    };
+
+    /*! \class HandoverReceiver
+        \brief The new process of a restart. It connects to the HandoverSender of the old process,
+            and takes over its listeners and connections.
+
+        Example:
+        \code
+        tnnf::HandoverReceiver handover;
+
+        if(handover.receive("/run/server.handover")) {
+            for(auto& i : handover.getListeners()) {
+                selector.add(i);
+            }
+            for(auto& i : handover.getConnections()) {
+                tnnf::PacketBuffer& buffer = buffers[i.socket.getSocket()];
+
+                i.restore(buffer);
+                selector.add(i.socket);
+            }
+        }
+        else {
+            //first start, make the listeners
+        }
+        \endcode*/
+    class HandoverReceiver {
+        public:
+            /*! \struct Connection
+                \brief A handed over connection.*/
+            struct Connection {
+                TcpSocket socket;
+                std::string pending; //!< received bytes, which were not handled by the old process
+
+                /*! \fn void restore(PacketBuffer& buffer)
+                    \brief Builds the pending bytes into the buffer of the connection. If the buffer
+                        can not take them, the common error callback is called with ERROR_PACKETBUFFER_TOO_SMALL,
+                        and the rest is dropped.
+                    \param buffer An empty buffer.*/
+                void restore(PacketBuffer& buffer) {
+                    size_t offset = 0;
+
+                    while(offset < pending.size()) {
+                        size_t length = std::min(pending.size() - offset, buffer.getWritableSize());
+
+                        if(length == 0) {
+                            gCommonErrorFunction(ERROR_PACKETBUFFER_TOO_SMALL, "PacketBuffer is full, the rest of the handed over bytes is dropped.");
+                            break;
+                        }
+                        memcpy(buffer.getWritable(), pending.data() + offset, length);
+                        buffer.buildPackets(length);
+                        offset += length;
+                    }
+                    pending.clear();
+                }
+            };
+
+        private:
+            // Receive the header of an item with its descriptor, -1 if it does not have one.
+            // The descriptor is closed if the header is broken.
+            bool receiveItem(const int& sock, HandoverHeader& header, int& descriptor) noexcept {
+                char control[CMSG_SPACE(sizeof(int))];
+                iovec vector = { &header, sizeof(header) };
+                msghdr message;
+
+                memset(&message, 0, sizeof(message));
+                message.msg_iov = &vector;
+                message.msg_iovlen = 1;
+                message.msg_control = control;
+                message.msg_controllen = sizeof(control);
+                descriptor = -1;
+
+                ssize_t received;
+                while((received = ::recvmsg(sock, &message, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {}
+
+                if(received <= 0) {
+                    return false;
+                }
+
+                for(cmsghdr* i = CMSG_FIRSTHDR(&message); i != nullptr; i = CMSG_NXTHDR(&message, i)) {
+                    if(i->cmsg_level == SOL_SOCKET && i->cmsg_type == SCM_RIGHTS) {
+                        memcpy(&descriptor, CMSG_DATA(i), sizeof(int));
+                    }
+                }
+
+                if(!ReadHandover(sock, ((char*) &header) + received, sizeof(header) - received)) {
+                    if(descriptor != -1) {
+                        close(descriptor);
+                        descriptor = -1;
+                    }
+                    return false;
+                }
+                header.kind = ntohl(header.kind);
+                header.length = ntohl(header.length);
+                return true;
+            }
+
+            std::vector<ListenerSocket> mListeners;
+            std::vector<Connection> mConnections;
+
+        protected:
+
+        public:
+            /*! \fn bool receive(const std::string& path)
+                \brief Connects to the old process, and takes over its sockets.
+                    If the transfer breaks, the common error callback is called with ERROR_HANDOVER_TRANSFER.
+                \param path The path of the HandoverSender.
+                \return false if there is no old process on the path, or the transfer failed,
+                    then the received sockets are closed, the old process keeps them*/
+            bool receive(const std::string& path) {
+                sockaddr_un address;
+                int sock;
+
+                if(!MakeHandoverAddress(path, address) || (sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) {
+                    return false;
+                }
+                if(::connect(sock, (sockaddr*) &address, sizeof(address)) == -1) {
+                    close(sock);
+                    return false;
+                }
+
+                HandoverHeader header;
+                int descriptor;
+                bool success;
+
+                size_t listeners = mListeners.size(), connections = mConnections.size();
+
+                while((success = receiveItem(sock, header, descriptor)) && header.kind != HANDOVER_END) {
+                    if(descriptor == -1) {
+                        success = false;
+                        break;
+                    }
+
+                    if(header.kind == HANDOVER_LISTENER) {
+                        mListeners.push_back(ListenerSocket::FromDescriptor(descriptor));
+                        continue;
+                    }
+
+                    std::string pending(header.length, '\0');
+                    if(!(success = ReadHandover(sock, &pending[0], header.length))) {
+                        close(descriptor);
+                        break;
+                    }
+                    mConnections.push_back(Connection{TcpSocket::FromDescriptor(descriptor), std::move(pending)});
+                }
+                if(success && descriptor != -1) { //the end does not have one
+                    close(descriptor);
+                }
+
+                char acknowledgement = 1;
+                success = success && WriteHandover(sock, &acknowledgement, 1);
+                close(sock);
+
+                if(!success) {
+                    mListeners.erase(mListeners.begin() + listeners, mListeners.end()); //closes the received ones
+                    mConnections.erase(mConnections.begin() + connections, mConnections.end());
+                    gCommonErrorFunction(ERROR_HANDOVER_TRANSFER, "Handover failed.");
+                }
+                return success;
+            }
+
+            /*! \fn std::vector<ListenerSocket>& getListeners()
+                \return the received listeners, in the order of HandoverSender::add()*/
+            std::vector<ListenerSocket>& getListeners() noexcept {
+                return mListeners;
+            }
+
+            /*! \fn std::vector<Connection>& getConnections()
+                \return the received connections, in the order of HandoverSender::add()*/
+            std::vector<Connection>& getConnections() noexcept {
+                return mConnections;
+            }
+    };
+}//tnnf
+
+#endif
@@ -24,6 +24,8 @@ freely, subject to the following restrictions:
 #ifndef TNNF_LISTENERSOCKET_HPP
 #define TNNF_LISTENERSOCKET_HPP
 
+#include <vector>
+
 #include "TcpSocket.hpp"
 
 namespace tnnf {
@@ -32,22 +34,33 @@ namespace tnnf {
     class ListenerSocket : public TcpSocket {
         private:
             unsigned int mQueueLength; //max queue
-            static socklen_t TNNF_SOCKADDR_LENGTH; //size of address.
+
+            ListenerSocket(const std::shared_ptr<int>& sock, const Address& address) noexcept : TcpSocket(sock, address), mQueueLength(0) {} //constructor for FromDescriptor method.
 
         protected:
 
         public:
-            /*! \fn ListenerSocket(const Address& address, unsigned int queueLength)
+            /*! \fn ListenerSocket(const Address& address, unsigned int queueLength, const bool& reusePort = false)
                 \brief Constructor. You have to specify an address, where the socket will
                     listen to connections, and the number, which describes
                     how many connections can wait for the acception at the same time.
                 \param address You have to specify the port too.
                 \param queueLength the length of the queue
+                \param reusePort Sets SO_REUSEPORT before binding, so more ListenerSockets
+                    can listen on the same address (for example one on every thread),
+                    and the kernel distributes the new connections between them.
                 \throw tnnf_error with error code TNNF_ERROR_SOCKET_CREATE
                 \throw tnnf_error with error code TNNF_ERROR_SOCKET_BIND, if the port is null,
                     or something failed at a binding.
                 \throw tnnf_error with error code TNNF_ERROR_SOCKET_LISTEN*/
-            ListenerSocket(const Address& address, unsigned int queueLength) : TcpSocket(address)  {
+            ListenerSocket(const Address& address, unsigned int queueLength, const bool& reusePort = false) :
+                TcpSocket(address),
+                mQueueLength(queueLength)
+            {
+                if(reusePort) {
+                    setSocketOption(SO_REUSEPORT, 1);
+                }
+
                 if(getAddress().getPort() == 0 || ::bind(getSocket(), getAddress().toSockaddr(), sizeof(sockaddr)) == -1) {
                     gSocketErrorFunction(*this, ERROR_SOCKET_BIND, errno);
                 }
@@ -57,6 +70,22 @@ namespace tnnf {
                 }
             }
 
+            /*! \fn static ListenerSocket FromDescriptor(const int& descriptor)
+                \brief Takes over a descriptor which is already listening, for example one received
+                    from another process (see Handover.hpp), so the waiting connections are not lost.
+                    The address is read with getsockname().
+                \param descriptor It is closed by the last copy of the socket.
+                \return with the listener*/
+            static ListenerSocket FromDescriptor(const int& descriptor) {
+                sockaddr_storage address;
+                socklen_t addressLength = sizeof(address);
+
+                memset(&address, 0, sizeof(address));
+                ::getsockname(descriptor, (sockaddr*)&address, &addressLength);
+
+                return ListenerSocket(std::make_shared<int>(descriptor), Address(address));
+            }
+
             /*! \fn Copy and Move constructors and assignments
                 \brief Copy and move are available.*/
             ListenerSocket(const ListenerSocket& other) = default;
@@ -86,16 +115,83 @@ namespace tnnf {
             TcpSocket accept() {
                 std::shared_ptr<int> sock = std::make_shared<int>(-1);
                 sockaddr_storage address;
+                socklen_t addressLength = sizeof(address);
 
-                if((*sock = ::accept(getSocket(), (sockaddr*)&address, &TNNF_SOCKADDR_LENGTH)) == -1) {
+                if((*sock = ::accept(getSocket(), (sockaddr*)&address, &addressLength)) == -1) {
                     gSocketErrorFunction(*this, ERROR_SOCKET_ACCEPT, errno);
                 }
 
                 return GetInstance(sock, Address(address));
             }
-    };
 
-    socklen_t ListenerSocket::TNNF_SOCKADDR_LENGTH = sizeof(sockaddr_storage); //set to big enough
+            /*! \fn TcpSocket tryAccept()
+                \brief Accepts a waiting connection of a non-blocking listener (see setBlocking()).
+                    If there is no waiting connection, errno is set to EAGAIN and the socket error
+                    callback is not called.
+                \return with a TcpSocket, which will be equal with -1 if there was no connection
+                    or an error occurred.*/
+            TcpSocket tryAccept() {
+                std::shared_ptr<int> sock = std::make_shared<int>(-1);
+                sockaddr_storage address;
+                socklen_t addressLength = sizeof(address);
+
+                if((*sock = ::accept(getSocket(), (sockaddr*)&address, &addressLength)) == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    gSocketErrorFunction(*this, ERROR_SOCKET_ACCEPT, errno);
+                }
+
+                return GetInstance(sock, Address(address));
+            }
+
+            /*! \fn size_t acceptAll(std::vector<TcpSocket>& connections, const size_t& budget = 0, const int& flags = SOCK_NONBLOCK | SOCK_CLOEXEC)
+                \brief Accepts the waiting connections of a non-blocking listener (see setBlocking())
+                    with accept4(), until the queue is empty or the budget is used up. A burst of
+                    connections is taken in one turn of the loop instead of one per readable event:
+                    \code
+                    std::vector<tnnf::TcpSocket> accepted; //reused, it keeps its capacity
+
+                    listener.setBlocking(false);
+                    selector.add(listener, tnnf::SocketHandlers{[&](tnnf::Socket&) {
+                        accepted.clear();
+                        listener.acceptAll(accepted, 64);
+
+                        for(auto& i : accepted) {
+                            selector.add(std::move(i), clientHandlers);
+                        }
+                    }});
+                    \endcode
+                    Errors other than an empty queue are reported through the socket error callback
+                    with ERROR_SOCKET_ACCEPT, and stop the accepting. ECONNABORTED is skipped.
+                \param connections The accepted sockets are appended to it.
+                \param budget The most connections to accept, 0 means no limit. In edge-triggered
+                    mode the rest is not reported again, so use 0 there.
+                \param flags Flags of the new descriptors, SOCK_NONBLOCK and SOCK_CLOEXEC by default.
+                \return the number of the accepted connections*/
+            size_t acceptAll(std::vector<TcpSocket>& connections, const size_t& budget = 0, const int& flags = SOCK_NONBLOCK | SOCK_CLOEXEC) {
+                size_t accepted = 0;
+                sockaddr_storage address;
+                socklen_t addressLength;
+                int descriptor;
+
+                while(budget == 0 || accepted < budget) {
+                    addressLength = sizeof(address);
+
+                    if((descriptor = ::accept4(getSocket(), (sockaddr*)&address, &addressLength, flags)) == -1) {
+                        if(errno == EINTR || errno == ECONNABORTED) {
+                            continue;
+                        }
+                        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                            gSocketErrorFunction(*this, ERROR_SOCKET_ACCEPT, errno);
+                        }
+                        break;
+                    }
+
+                    connections.push_back(GetInstance(std::make_shared<int>(descriptor), Address(address)));
+                    accepted++;
+                }
+
+                return accepted;
+            }
+    };
 }//tnnf
 
 #endif
@@ -0,0 +1,161 @@
+/*! \file LoopStats.hpp
+    \brief Counters and histograms of an event loop.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_LOOPSTATS_HPP
+#define TNNF_LOOPSTATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tnnf {
+    /*! \class Histogram
+        \brief Counts values in power of two buckets: bucket 0 holds 0, bucket i holds
+            the values from 2^(i-1) to 2^i - 1.
+
+        It is written by one thread (the loop) without atomic read-modify-write, and it can
+        be read from any thread at the same time. The reader can see a value in the count
+        before it is in a bucket, the numbers are consistent only when the loop is idle.*/
+    class Histogram {
+        public:
+            static const size_t BUCKETS = 65; //!< number of the buckets
+
+        private:
+            // Add to a counter, which is written only by the loop.
+            static void add(std::atomic<uint64_t>& counter, const uint64_t& value) noexcept {
+                counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+
+            std::atomic<uint64_t> mBuckets[BUCKETS];
+            std::atomic<uint64_t> mCount; //number of the values
+            std::atomic<uint64_t> mSum; //sum of the values
+            std::atomic<uint64_t> mMax; //the biggest value
+
+        protected:
+
+        public:
+            Histogram() noexcept :
+                mCount(0),
+                mSum(0),
+                mMax(0)
+            {
+                for(auto& i : mBuckets) {
+                    i.store(0, std::memory_order_relaxed);
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted.*/
+            Histogram(const Histogram& other) = delete;
+            Histogram& operator=(const Histogram& other) = delete;
+
+            /*! \fn static size_t GetBucket(const uint64_t& value)
+                \return the index of the bucket of the value*/
+            static size_t GetBucket(const uint64_t& value) noexcept {
+                return value == 0 ? 0 : 64 - __builtin_clzll(value);
+            }
+
+            /*! \fn void record(const uint64_t& value)
+                \brief Counts a value. Call it only from the thread of the loop.
+                \param value*/
+            void record(const uint64_t& value) noexcept {
+                add(mBuckets[GetBucket(value)], 1);
+                add(mCount, 1);
+                add(mSum, value);
+
+                if(value > mMax.load(std::memory_order_relaxed)) {
+                    mMax.store(value, std::memory_order_relaxed);
+                }
+            }
+
+            /*! \fn uint64_t getBucket(const size_t& index)
+                \return the number of the values in the bucket*/
+            uint64_t getBucket(const size_t& index) const noexcept {
+                return mBuckets[index].load(std::memory_order_relaxed);
+            }
+
+            /*! \fn uint64_t getCount()
+                \return the number of the values*/
+            uint64_t getCount() const noexcept {
+                return mCount.load(std::memory_order_relaxed);
+            }
+
+            /*! \fn uint64_t getSum()
+                \return the sum of the values*/
+            uint64_t getSum() const noexcept {
+                return mSum.load(std::memory_order_relaxed);
+            }
+
+            /*! \fn uint64_t getMax()
+                \return the biggest value*/
+            uint64_t getMax() const noexcept {
+                return mMax.load(std::memory_order_relaxed);
+            }
+
+            /*! \fn uint64_t getMean()
+                \return the average of the values, 0 if there is none*/
+            uint64_t getMean() const noexcept {
+                uint64_t count = getCount();
+                return count == 0 ? 0 : getSum() / count;
+            }
+
+            /*! \fn uint64_t getPercentile(const double& percentile)
+                \brief The result is the upper bound of the bucket, so it is at most twice the real value.
+                \param percentile between 0 and 100, for example 99 for the p99.
+                \return the value, which is not exceeded by the given percent of the values*/
+            uint64_t getPercentile(const double& percentile) const noexcept {
+                uint64_t count = 0;
+                uint64_t total = 0;
+
+                for(auto& i : mBuckets) {
+                    total += i.load(std::memory_order_relaxed);
+                }
+
+                uint64_t target = (uint64_t) (total * percentile / 100.0 + 0.5);
+                for(size_t i = 0; i < BUCKETS; i++) {
+                    count += getBucket(i);
+
+                    if(count >= target && count > 0) {
+                        return i == 0 ? 0 : (i == 64 ? UINT64_MAX : (1ull << i) - 1);
+                    }
+                }
+                return 0;
+            }
+    };
+
+    /*! \struct LoopStats
+        \brief The numbers of an event loop, see EpollSelector::getStats().
+            The times are in nanoseconds, and counted only while the statistics are enabled.*/
+    struct LoopStats {
+        std::atomic<uint64_t> iterations;   //!< number of the update() calls
+        Histogram waitTime;                 //!< time spent waiting in the kernel (and spinning) in an update()
+        Histogram busyTime;                 //!< loop lag: the time from the end of a wait to the beginning of the next one
+        Histogram readyCount;               //!< number of the events returned by a wait
+        Histogram syscalls;                 //!< number of the epoll, eventfd and send calls of the selector in an iteration
+        Histogram handlerTime;              //!< time of the handlers and waiters of one socket
+
+        LoopStats() noexcept : iterations(0) {}
+    };
+}//tnnf
+
+#endif
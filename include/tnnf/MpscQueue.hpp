@@ -0,0 +1,119 @@
+/*! \file MpscQueue.hpp
+    \brief Lock-free queue with many producer threads and one consumer thread.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_MPSCQUEUE_HPP
+#define TNNF_MPSCQUEUE_HPP
+
+#include <atomic>
+#include <utility>
+
+namespace tnnf {
+    /*! \class MpscQueue
+        \brief Unbounded linked queue. push() can be called from any thread, it is one
+            atomic exchange. pop() and isEmpty() can be called only from one thread.
+
+        The consumer always holds a dummy node, and a value is taken from the node after it,
+        which becomes the next dummy. A push() which is between its exchange and its link
+        is not visible for pop() yet, but isEmpty() already returns false.
+        \tparam T Default constructible and movable type.*/
+    template<typename T>
+    class MpscQueue {
+        private:
+            // One element.
+            struct Node {
+                std::atomic<Node*> next;
+                T value;
+
+                Node() : next(nullptr) {}
+                explicit Node(T&& item) : next(nullptr), value(std::move(item)) {}
+            };
+
+            std::atomic<Node*> mHead; //the last pushed node, changed by the producers
+            Node* mTail; //the dummy node, owned by the consumer
+
+        protected:
+
+        public:
+            /*! \fn MpscQueue()
+                \brief Constructor. Allocates the first dummy node.*/
+            MpscQueue() :
+                mHead(nullptr),
+                mTail(new Node())
+            {
+                mHead.store(mTail, std::memory_order_relaxed);
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted.*/
+            MpscQueue(const MpscQueue& other) = delete;
+            MpscQueue& operator=(const MpscQueue& other) = delete;
+            MpscQueue(MpscQueue&& other) = delete;
+            MpscQueue& operator=(MpscQueue&& other) = delete;
+
+            /*! \fn ~MpscQueue()
+                \brief Destructor. Destroys the remaining values, no push() can run at the same time.*/
+            ~MpscQueue() {
+                while(mTail != nullptr) {
+                    Node* next = mTail->next.load(std::memory_order_relaxed);
+                    delete mTail;
+                    mTail = next;
+                }
+            }
+
+            /*! \fn void push(T item)
+                \brief Appends a value. It can be called from any thread.
+                \param item*/
+            void push(T item) {
+                Node* node = new Node(std::move(item));
+                Node* previous = mHead.exchange(node, std::memory_order_seq_cst); //ordered before the check of a sleeping consumer
+                previous->next.store(node, std::memory_order_release);
+            }
+
+            /*! \fn bool pop(T& item)
+                \brief Takes the first value. Only the consumer thread can call it.
+                \param item The value is moved here.
+                \return false if there is no complete value*/
+            bool pop(T& item) {
+                Node* next = mTail->next.load(std::memory_order_acquire);
+
+                if(next == nullptr) {
+                    return false;
+                }
+
+                item = std::move(next->value);
+                next->value = T();
+                delete mTail;
+                mTail = next;
+                return true;
+            }
+
+            /*! \fn bool isEmpty()
+                \brief Only the consumer thread can call it.
+                \return true if nothing was pushed since the last value was taken*/
+            bool isEmpty() const noexcept {
+                return mHead.load(std::memory_order_seq_cst) == mTail;
+            }
+    };
+}//tnnf
+
+#endif
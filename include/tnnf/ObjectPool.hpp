@@ -0,0 +1,162 @@
+/*! \file ObjectPool.hpp
+    \brief Fixed size object allocator, which reuses the freed objects.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_OBJECTPOOL_HPP
+#define TNNF_OBJECTPOOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tnnf {
+    /*! \class ObjectPool
+        \brief Allocates objects from chunks, and keeps the destroyed ones in a free list.
+
+        The memory is allocated in chunks of ChunkSize objects and it is given back only
+        by the destructor, so after the pool has grown to the peak number of objects,
+        create() and destroy() do not touch the heap. The objects never move.
+        It is not thread safe.
+        \tparam T Type of the objects.
+        \tparam ChunkSize Number of objects allocated at once.*/
+    template<typename T, size_t ChunkSize = 256>
+    class ObjectPool {
+        private:
+            // Memory of one object, or a link of the free list.
+            union Node {
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+                Node* next;
+            };
+
+            // Allocate a new chunk, and put its objects to the free list.
+            void grow() {
+                Node* chunk = new Node[ChunkSize];
+                mChunks.emplace_back(chunk);
+
+                for(size_t i = 0; i < ChunkSize; i++) {
+                    chunk[i].next = mFree;
+                    mFree = &chunk[i];
+                }
+            }
+
+            std::vector<std::unique_ptr<Node[]>> mChunks; //all memory
+            Node* mFree; //head of the free list
+            size_t mSize; //number of living objects
+
+        protected:
+
+        public:
+            /*! \fn ObjectPool()
+                \brief Constructor. Nothing is allocated until the first create().*/
+            ObjectPool() noexcept :
+                mFree(nullptr),
+                mSize(0)
+            {
+
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy methods deleted. Moving methods are available, the objects stay at their place.*/
+            ObjectPool(const ObjectPool& other) = delete;
+            ObjectPool& operator=(const ObjectPool& other) = delete;
+
+            ObjectPool(ObjectPool&& other) noexcept :
+                mChunks(std::move(other.mChunks)),
+                mFree(other.mFree),
+                mSize(other.mSize)
+            {
+                other.mChunks.clear();
+                other.mFree = nullptr;
+                other.mSize = 0;
+            }
+
+            ObjectPool& operator=(ObjectPool&& other) noexcept {
+                std::swap(mChunks, other.mChunks);
+                std::swap(mFree, other.mFree);
+                std::swap(mSize, other.mSize);
+                return *this;
+            }
+
+            /*! \fn ~ObjectPool()
+                \brief Destructor. Frees the memory, the living objects have to be destroyed before.*/
+            ~ObjectPool() {}
+
+            /*! \fn T* create(Args&&... args)
+                \brief Constructs an object.
+                \param args The arguments of the constructor of T.
+                \return the new object*/
+            template<typename... Args>
+            T* create(Args&&... args) {
+                if(mFree == nullptr) {
+                    grow();
+                }
+
+                Node* node = mFree;
+                mFree = node->next; //the object overwrites the link
+
+                T* object;
+                try {
+                    object = new(&node->storage) T(std::forward<Args>(args)...);
+                }
+                catch(...) {
+                    node->next = mFree;
+                    mFree = node;
+                    throw;
+                }
+                mSize++;
+
+                return object;
+            }
+
+            /*! \fn void destroy(T* object)
+                \brief Destructs an object, and keeps its memory for the next create().
+                \param object It has to be created by this pool.*/
+            void destroy(T* object) noexcept {
+                object->~T();
+
+                Node* node = reinterpret_cast<Node*>(object);
+                node->next = mFree;
+                mFree = node;
+                mSize--;
+            }
+
+            /*! \fn void reserve(const size_t& count)
+                \brief Allocates memory in advance for count objects.
+                \param count*/
+            void reserve(const size_t& count) {
+                while(mChunks.size() * ChunkSize < count) {
+                    grow();
+                }
+            }
+
+            /*! \fn size_t getSize()
+                \return the number of living objects*/
+            size_t getSize() const noexcept {
+                return mSize;
+            }
+    };
+}//tnnf
+
+#endif
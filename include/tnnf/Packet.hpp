@@ -27,6 +27,10 @@ freely, subject to the following restrictions:
 #include <arpa/inet.h>
 
 #include <limits>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 #include "tnnf.hpp"
 
@@ -73,6 +77,32 @@ namespace tnnf {
                 }
             }
 
+            /*! \fn void assign(const uint16_t& type, const char* data, const size_t& size)
+                \brief Replaces the content like the constructor, but it reuses the memory of the data,
+                    so it does not allocate if the new data is not longer than the capacity.
+                \param type A number between 0 and 65534. (65535 is reserved for empty packets)
+                \param data Your serialized data.
+                \param size Size of the data.*/
+            void assign(const uint16_t& type, const char* data, const size_t& size) {
+                if(type == EMPTY_PACKET_TYPE) {
+                    mType = EMPTY_PACKET_TYPE;
+                    mSize = 2 * sizeof(uint16_t);
+                    mData.clear();
+                }
+                else if(size > maxSize - 2 * sizeof(uint16_t)) {
+                    mType = EMPTY_PACKET_TYPE;
+                    mSize = 2 * sizeof(uint16_t);
+                    mData.clear();
+
+                    gCommonErrorFunction(ERROR_PACKET_TOO_BIG, "Packet size too big.");
+                }
+                else {
+                    mType = type;
+                    mData.assign(data, size);
+                    mSize = size + 2 * sizeof(uint16_t);
+                }
+            }
+
             /*! \fn Copy and Move constructors and assignments
                 \brief Copy and move are available.*/
             Packet(const Packet& other) = default;
@@ -116,6 +146,17 @@ namespace tnnf {
                 return mData;
             }
 
+            /*! \fn void serialize(std::string& out)
+                \brief Appends the packet to the end of out in the format, as it is sent
+                    through the network: size and type in network byte order, then the data.
+                \param out*/
+            void serialize(std::string& out) const {
+                uint16_t header[2] = { htons(mSize), htons(mType) };
+
+                out.append((const char*) header, sizeof(header));
+                out.append(mData);
+            }
+
             /*! \var maxSize
                 \brief Maximum packet size.*/
             static uint16_t maxSize;
@@ -125,6 +166,35 @@ namespace tnnf {
             static uint16_t EMPTY_PACKET_TYPE;
     };
 
+    /*! \struct PacketView
+        \brief A received packet, which is not copied out of its PacketBuffer.
+            It is valid until the buffer is consumed, see PacketBuffer::getViews().*/
+    struct PacketView {
+        uint16_t type;      //!< type of the packet
+        const char* data;   //!< the payload in the buffer, it is not null terminated
+        size_t size;        //!< size of the payload
+
+#if __cplusplus >= 201703L
+        /*! \fn std::string_view getPayload()
+            \return the payload without copying*/
+        std::string_view getPayload() const noexcept {
+            return std::string_view(data, size);
+        }
+#endif
+
+        /*! \fn std::string toString()
+            \return a copy of the payload*/
+        std::string toString() const {
+            return std::string(data, size);
+        }
+
+        /*! \fn Packet toPacket()
+            \return a copy of the packet, which stays valid*/
+        Packet toPacket() const {
+            return Packet(type, toString());
+        }
+    };
+
     uint16_t Packet::maxSize = std::numeric_limits<uint16_t>::max(); //default 65535
     uint16_t Packet::EMPTY_PACKET_TYPE = std::numeric_limits<uint16_t>::max(); //default 65535
 }//tnnf
@@ -24,20 +24,290 @@ freely, subject to the following restrictions:
 #ifndef TNNF_PACKETBUFFER_HPP
 #define TNNF_PACKETBUFFER_HPP
 
-#include <sstream>
+#include <algorithm>
 #include <cstring>
 #include <queue>
+#include <string>
 
+#include "BufferPool.hpp"
 #include "Packet.hpp"
 
 namespace tnnf {
     /*! \class PacketBuffer
-        \brief This class builds packets from bytes and */
+        \brief This class builds packets from bytes and stores them.
+
+        The received bytes are parsed in place: a built packet only moves the read cursor,
+        so the bytes behind it are not shifted. The unparsed rest is moved to the front only
+        when the rest of its packet would not fit behind it. Receive into it like this:
+        \code
+        ssize_t received = ::recv(fd, buffer.getWritable(), buffer.getWritableSize(), 0);
+
+        if(received > 0) {
+            buffer.buildPackets(received);
+        }
+        \endcode
+        Instead of building Packets, the packets can be read where they are, with commit()
+        and getViews(), so the payload is not copied:
+        \code
+        ssize_t received = ::recv(fd, buffer.getWritable(), buffer.getWritableSize(), 0);
+
+        if(received > 0) {
+            buffer.commit(received);
+
+            for(const tnnf::PacketView& view : buffer.getViews()) {
+                forward(view.type, view.data, view.size);
+            }
+            buffer.consume(); //the views are invalid after it
+        }
+        \endcode
+        An elastic PacketBuffer, PacketBuffer(minSize, maxSize), starts small, and doubles when a packet
+        does not fit. It keeps a moving average of the packet sizes of its connection, and settles
+        at the size which holds about FRAMES_PER_READ of them: it grows to it at once, and shrinks
+        to it after SHRINK_AFTER reads in a row, where the incomplete packet fits in half of it.
+        A pooled PacketBuffer (see BufferPool) has memory only while it holds an incomplete packet.
+        Use getWritable() with it, and if the packets are read with getViews(), call consume()
+        before the next buffer of the pool receives.*/
     class PacketBuffer {
+        public:
+            static const size_t FRAMES_PER_READ = 16;  //!< an elastic buffer holds this many average packets
+            static const size_t SHRINK_AFTER = 64;     //!< an elastic buffer shrinks after this many reads with small packets
+
+            /*! \class ViewIterator
+                \brief Walks the complete packets of the buffer, see getViews().*/
+            class ViewIterator {
+                private:
+                    // Read the packet at the cursor, or become the end.
+                    void load() noexcept {
+                        bool invalid = false;
+
+                        if((mPacketSize = Parse(mCursor, mLast - mCursor, mView, invalid)) == 0) {
+                            mCursor = nullptr;
+                        }
+                    }
+
+                    const char* mCursor; //the current packet, nullptr at the end
+                    const char* mLast; //the end of the unparsed bytes
+                    PacketView mView;
+                    size_t mPacketSize; //of the current packet with its header
+
+                public:
+                    ViewIterator() noexcept :
+                        mCursor(nullptr),
+                        mLast(nullptr),
+                        mPacketSize(0)
+                    {}
+
+                    ViewIterator(const char* first, const char* last) noexcept :
+                        mCursor(first),
+                        mLast(last),
+                        mPacketSize(0)
+                    {
+                        load();
+                    }
+
+                    const PacketView& operator*() const noexcept { return mView; }
+                    const PacketView* operator->() const noexcept { return &mView; }
+
+                    ViewIterator& operator++() noexcept {
+                        mCursor += mPacketSize;
+                        load();
+                        return *this;
+                    }
+
+                    bool operator==(const ViewIterator& other) const noexcept { return mCursor == other.mCursor; }
+                    bool operator!=(const ViewIterator& other) const noexcept { return mCursor != other.mCursor; }
+            };
+
+            /*! \struct ViewRange
+                \brief The complete packets of the buffer for a range-based for loop.*/
+            struct ViewRange {
+                ViewIterator first;
+
+                ViewIterator begin() const noexcept { return first; }
+                ViewIterator end() const noexcept { return ViewIterator(); }
+            };
+
         private:
+            // Read a number in network byte order. The packets are not aligned in the buffer.
+            static uint16_t ReadShort(const char* bytes) noexcept {
+                uint16_t value;
+                memcpy(&value, bytes, sizeof(value));
+                return ntohs(value);
+            }
+
+            /* Read the packet at the start of the bytes. Returns its size with the header, 0 if it is
+               not complete yet, or if its size is smaller than its header, then invalid is set.*/
+            static size_t Parse(const char* bytes, const size_t& length, PacketView& view, bool& invalid) noexcept {
+                if(length < 2 * sizeof(uint16_t)) {
+                    return 0;
+                }
+
+                size_t packetSize = ReadShort(bytes);
+                if(packetSize < 2 * sizeof(uint16_t)) {
+                    invalid = true;
+                    return 0;
+                }
+                if(length < packetSize) {
+                    return 0;
+                }
+
+                view.type = ReadShort(bytes + sizeof(uint16_t));
+                view.data = bytes + 2 * sizeof(uint16_t);
+                view.size = packetSize - 2 * sizeof(uint16_t);
+                return packetSize;
+            }
+
+            // Add a packet size to the moving average of the connection.
+            void estimate(const size_t& packetSize) noexcept {
+                mEstimate = mEstimate - (mEstimate >> 3) + ((packetSize << 4) >> 3); //1/8 weight, 4 fraction bits
+            }
+
+            // The size which an elastic buffer settles at.
+            size_t getTargetSize() const noexcept {
+                size_t wanted = (mEstimate >> 4) * FRAMES_PER_READ;
+                size_t size = mMinSize;
+
+                while(size < wanted && size < mMaxSize) {
+                    size *= 2;
+                }
+                return std::min(size, mMaxSize);
+            }
+
+            // Move the unparsed bytes into a new buffer of an elastic PacketBuffer.
+            void resize(const size_t& size) {
+                size_t stored = mEnd - mStart;
+                char* buffer = new char[size];
+
+                memcpy(buffer, mBuffer + mStart, stored);
+                delete[] mBuffer;
+
+                mBuffer = buffer;
+                mSize = size;
+                mStart = 0;
+                mEnd = stored;
+                mCalmTurns = 0;
+            }
+
+            /* Grow an elastic buffer for a packet which does not fit, or move it towards its target size.
+               Returns true if the buffer is replaced.*/
+            bool fit(const size_t& needed) {
+                if(needed > mSize) {
+                    size_t size = mSize;
+                    while(size < needed) {
+                        size *= 2;
+                    }
+                    resize(std::min(size, mMaxSize));
+                    return true;
+                }
+
+                size_t target = getTargetSize();
+                if(target > mSize) {
+                    resize(target);
+                    return true;
+                }
+                if(target == mSize || needed > target / 2) { //not small traffic
+                    mCalmTurns = 0;
+                }
+                else if(++mCalmTurns >= SHRINK_AFTER) {
+                    resize(target);
+                    return true;
+                }
+                return false;
+            }
+
+            // Drop the unparsed bytes of a stream which can not be followed.
+            void dropInvalid() noexcept {
+                gCommonErrorFunction(ERROR_PACKET_INVALID_SIZE, "Packet size is smaller than the header, the received bytes are dropped.");
+                mStart = mEnd;
+            }
+
+            // Move the unparsed bytes to the front of the buffer.
+            void compact() noexcept {
+                if(mStart > 0) {
+                    memmove(mBuffer, mBuffer + mStart, mEnd - mStart);
+                    mEnd -= mStart;
+                    mStart = 0;
+                }
+            }
+
+            // The bytes which the unparsed packet needs: its size if it is known, the stored bytes otherwise.
+            size_t getNeededSize() const noexcept {
+                size_t stored = mEnd - mStart;
+
+                if(stored >= sizeof(uint16_t)) {
+                    return std::max(stored, (size_t) ReadShort(mBuffer + mStart));
+                }
+                return sizeof(uint16_t);
+            }
+
+            // Move the unparsed bytes into a borrowed buffer of the pool, which can hold the whole packet.
+            void borrow() {
+                size_t stored = mEnd - mStart;
+                size_t capacity = 0;
+                char* buffer = mPool->acquire(getNeededSize(), capacity);
+
+                memcpy(buffer, mBuffer + mStart, stored);
+                giveBack();
+
+                mBuffer = buffer;
+                mSize = capacity;
+                mStart = 0;
+                mEnd = stored;
+            }
+
+            // Give the memory back to the pool, or leave the scratch buffer.
+            void giveBack() noexcept {
+                if(mBuffer != nullptr && !mScratch) {
+                    mPool->release(mBuffer, mSize);
+                }
+
+                mBuffer = nullptr;
+                mSize = 0;
+                mStart = 0;
+                mEnd = 0;
+                mScratch = false;
+            }
+
+            // After parsing: free the buffer, or make room for the rest of the next packet.
+            void compactIfNeeded() {
+                size_t stored = mEnd - mStart;
+
+                if(stored == 0) {
+                    if(mPool != nullptr) {
+                        giveBack();
+                    }
+                    mStart = 0;
+                    mEnd = 0;
+
+                    if(mMaxSize > 0) {
+                        fit(0);
+                    }
+                    return;
+                }
+
+                size_t needed = getNeededSize();
+                if(mPool != nullptr && (mScratch || needed > mSize)) { //keep only the incomplete packet, in its own memory
+                    borrow();
+                    return;
+                }
+                if(mMaxSize > 0 && fit(needed)) {
+                    return;
+                }
+
+                if(mSize - mEnd < needed - stored || mSize - mEnd < mSize / 4) { //short reads would cost more than the move
+                    compact();
+                }
+            }
+
             char* mBuffer; //recieved bytes
-            size_t mSize, mCurrentlyStoredBytes; //size of the buffer, and how much is filled
+            size_t mSize; //size of the buffer
+            size_t mStart, mEnd; //the unparsed bytes are between them
             std::queue<Packet> mStoredPackets; //completed packages
+            BufferPool* mPool; //the memory of a pooled buffer, nullptr if it owns its buffer
+            bool mScratch; //mBuffer is the scratch buffer of mPool
+            size_t mMinSize, mMaxSize; //limits of an elastic buffer, mMaxSize is 0 if the size is fixed
+            size_t mEstimate; //moving average of the packet sizes, with 4 fraction bits
+            size_t mCalmTurns; //the buffer was bigger than needed after this many reads in a row
 
         protected:
 
@@ -52,7 +322,14 @@ namespace tnnf {
             explicit PacketBuffer(const size_t& size = Packet::maxSize) :
                 mBuffer(nullptr),
                 mSize(size),
-                mCurrentlyStoredBytes(0)
+                mStart(0),
+                mEnd(0),
+                mPool(nullptr),
+                mScratch(false),
+                mMinSize(0),
+                mMaxSize(0),
+                mEstimate(0),
+                mCalmTurns(0)
             {
                 if(size >= Packet::maxSize) {
                     mBuffer = new char[mSize];
@@ -62,34 +339,111 @@ namespace tnnf {
                 }
             }
 
+            /*! \fn PacketBuffer(BufferPool& pool)
+                \brief Constructor of a pooled buffer. It does not have memory until it holds an incomplete packet.
+                \param pool It has to live longer than the buffer.*/
+            explicit PacketBuffer(BufferPool& pool) noexcept :
+                mBuffer(nullptr),
+                mSize(0),
+                mStart(0),
+                mEnd(0),
+                mPool(&pool),
+                mScratch(false),
+                mMinSize(0),
+                mMaxSize(0),
+                mEstimate(0),
+                mCalmTurns(0)
+            {}
+
+            /*! \fn PacketBuffer(const size_t& minSize, const size_t& maxSize)
+                \brief Constructor of an elastic buffer, for stream sockets. A datagram which is longer
+                    than the free space would be truncated.
+                \param minSize The initial and the smallest size.
+                \param maxSize The biggest size. It is raised to Packet::maxSize, so every packet fits.*/
+            PacketBuffer(const size_t& minSize, const size_t& maxSize) :
+                mBuffer(nullptr),
+                mSize(std::max(minSize, 2 * sizeof(uint16_t))),
+                mStart(0),
+                mEnd(0),
+                mPool(nullptr),
+                mScratch(false),
+                mMinSize(mSize),
+                mMaxSize(std::max(std::max(maxSize, mMinSize), (size_t) Packet::maxSize)),
+                mEstimate(0),
+                mCalmTurns(0)
+            {
+                mBuffer = new char[mSize];
+            }
+
             /*! \fn Copy and Move constructors and assignments
-                \brief Copy and move are available.*/
+                \brief Copy and move are available. The copy of a pooled buffer uses the same pool.*/
             PacketBuffer(const PacketBuffer& other) :
                 mBuffer(nullptr),
                 mSize(other.mSize),
-                mCurrentlyStoredBytes(other.mCurrentlyStoredBytes),
-                mStoredPackets(other.mStoredPackets)
+                mStart(0),
+                mEnd(other.mEnd - other.mStart),
+                mStoredPackets(other.mStoredPackets),
+                mPool(other.mPool),
+                mScratch(false),
+                mMinSize(other.mMinSize),
+                mMaxSize(other.mMaxSize),
+                mEstimate(other.mEstimate),
+                mCalmTurns(other.mCalmTurns)
             {
-                mBuffer = new char[mSize];
+                if(mPool == nullptr) {
+                    mBuffer = new char[mSize];
+                }
+                else if(mEnd > 0) {
+                    mBuffer = mPool->acquire(other.getNeededSize(), mSize);
+                }
+                else {
+                    mSize = 0;
+                }
 
-                for(size_t i = 0; i < mCurrentlyStoredBytes; i++) {
-                    mBuffer[i] = other.mBuffer[i];
+                if(mEnd > 0) {
+                    memcpy(mBuffer, other.mBuffer + other.mStart, mEnd);
                 }
             }
 
             PacketBuffer& operator=(const PacketBuffer& other) {
-                mBuffer = new char[other.mSize];
-                mSize = other.mSize;
-                mCurrentlyStoredBytes = other.mCurrentlyStoredBytes;
-                mStoredPackets = other.mStoredPackets;
+                PacketBuffer temp(other);
+                return *this = std::move(temp);
+            }
 
-                for(size_t i = 0; i < mCurrentlyStoredBytes; i++) {
-                    mBuffer[i] = other.mBuffer[i];
-                }
+            PacketBuffer(PacketBuffer&& other) noexcept :
+                mBuffer(other.mBuffer),
+                mSize(other.mSize),
+                mStart(other.mStart),
+                mEnd(other.mEnd),
+                mStoredPackets(std::move(other.mStoredPackets)),
+                mPool(other.mPool),
+                mScratch(other.mScratch),
+                mMinSize(other.mMinSize),
+                mMaxSize(other.mMaxSize),
+                mEstimate(other.mEstimate),
+                mCalmTurns(other.mCalmTurns)
+            {
+                other.mBuffer = nullptr;
+                other.mSize = 0;
+                other.mStart = 0;
+                other.mEnd = 0;
+                other.mScratch = false;
             }
 
-            PacketBuffer(PacketBuffer&& other) noexcept = default;
-            PacketBuffer& operator=(PacketBuffer&& other) = default;
+            PacketBuffer& operator=(PacketBuffer&& other) noexcept {
+                std::swap(mBuffer, other.mBuffer);
+                std::swap(mSize, other.mSize);
+                std::swap(mStart, other.mStart);
+                std::swap(mEnd, other.mEnd);
+                std::swap(mStoredPackets, other.mStoredPackets);
+                std::swap(mPool, other.mPool);
+                std::swap(mScratch, other.mScratch);
+                std::swap(mMinSize, other.mMinSize);
+                std::swap(mMaxSize, other.mMaxSize);
+                std::swap(mEstimate, other.mEstimate);
+                std::swap(mCalmTurns, other.mCalmTurns);
+                return *this;
+            }
 
             /*! \fn void swap(PacketBuffer& other)
                 \brief Swap the references between two PacketBuffers
@@ -102,44 +456,93 @@ namespace tnnf {
 
             //destructor
             ~PacketBuffer() {
-                if(mBuffer != nullptr) {
+                if(mPool != nullptr) {
+                    giveBack();
+                }
+                else if(mBuffer != nullptr) {
                     delete[] mBuffer;
                 }
             }
 
             /*! \fn void buildPackets(const int& receivedBytes)
                 \brief Build Packets from received bytes.
-                \param receivedBytes*/
-            void buildPackets(const int& receivedBytes) noexcept {
-                mCurrentlyStoredBytes += receivedBytes;
-                char* cursor = &mBuffer[0];
-                uint16_t packetSize = 0;
-
-                while(mCurrentlyStoredBytes >= sizeof(uint16_t)) { //if the buffer store enough bytes to get the size of the next packet
-                    packetSize = ntohs( *((uint16_t*) cursor));
-
-                    if(mCurrentlyStoredBytes >= packetSize) { //if there is the full packet
-                        std::stringstream ss;
-                        for(uint16_t i = 2 * sizeof(uint16_t); i < packetSize; i++) { //get the data
-                            ss << mBuffer[i];
-                        }
+                \param receivedBytes Written to getWritable().*/
+            void buildPackets(const int& receivedBytes) {
+                buildPackets(receivedBytes, [this](Packet& packet) {
+                    mStoredPackets.push(std::move(packet));
+                });
+            }
 
-                        cursor = &mBuffer[sizeof(uint16_t)];
-                        mStoredPackets.emplace(ntohs( *((uint16_t*) cursor)), ss.str()); //construct a new packet
+            /*! \fn void buildPackets(const int& receivedBytes, Function&& onPacket)
+                \brief Build Packets from received bytes, and give them to onPacket instead of storing them.
+                \param receivedBytes Written to getWritable().
+                \param onPacket Called with every completed packet, in order. It can move the packet away, otherwise its memory is reused for the next one.
+                \tparam Function void(Packet&)*/
+            template<typename Function>
+            void buildPackets(const int& receivedBytes, Function&& onPacket) {
+                mEnd += receivedBytes;
+                PacketView view;
+                Packet packet; //reused, its data is allocated again only if onPacket moved it away
+                bool invalid = false;
+                size_t packetSize = 0;
 
-                        for(uint16_t i = packetSize; i < mCurrentlyStoredBytes; i++) { //shrink the buffer
-                            mBuffer[i - packetSize] = mBuffer[i];
-                        }
+                while((packetSize = Parse(mBuffer + mStart, mEnd - mStart, view, invalid)) > 0) { //if there is the full packet
+                    packet.assign(view.type, view.data, view.size);
 
-                        mCurrentlyStoredBytes -= packetSize;
-                        cursor = &mBuffer[mCurrentlyStoredBytes];
-                        memset(cursor, 0, packetSize);
-                        cursor = &mBuffer[0];
-                    }
-                    else {
-                        break;
-                    }
+                    mStart += packetSize;
+                    estimate(packetSize);
+                    onPacket(packet);
                 }
+                if(invalid) {
+                    dropInvalid();
+                }
+
+                compactIfNeeded();
+            }
+
+            /*! \fn void commit(const int& receivedBytes)
+                \brief Adds the received bytes without building packets, so they can be read with getViews().
+                \param receivedBytes Written to getWritable().*/
+            void commit(const int& receivedBytes) noexcept {
+                mEnd += receivedBytes;
+            }
+
+            /*! \fn ViewRange getViews()
+                \brief The complete packets which are not consumed yet, in order. The views point into the buffer,
+                    they are valid until consume(), buildPackets() or getBuffer() is called.
+                \return the packets for a range-based for loop*/
+            ViewRange getViews() const noexcept {
+                return ViewRange{ViewIterator(mBuffer + mStart, mBuffer + mEnd)};
+            }
+
+            /*! \fn void consume()
+                \brief Drops every complete packet, the incomplete one stays. If the size of a packet
+                    is smaller than its header, the common error callback is called with
+                    ERROR_PACKET_INVALID_SIZE and the bytes are dropped.*/
+            void consume() {
+                PacketView view;
+                bool invalid = false;
+                size_t packetSize = 0;
+
+                while((packetSize = Parse(mBuffer + mStart, mEnd - mStart, view, invalid)) > 0) {
+                    mStart += packetSize;
+                    estimate(packetSize);
+                }
+                if(invalid) {
+                    dropInvalid();
+                }
+
+                compactIfNeeded();
+            }
+
+            /*! \fn void consume(const PacketView& view)
+                \brief Drops the packets until the view, and the packet of the view too, for example
+                    when the rest is handled later. Every view is invalid after it.
+                \param view One of getViews().*/
+            void consume(const PacketView& view) {
+                mStart = view.data + view.size - mBuffer;
+                estimate(view.size + 2 * sizeof(uint16_t));
+                compactIfNeeded();
             }
 
             /*! \fn bool isPacketStored()
@@ -148,35 +551,69 @@ namespace tnnf {
                 return !mStoredPackets.empty();
             }
 
-            /*! \fn const size_t& getNumOfStoredPackets()
-                \return a constant reference to number of completed packets*/
-            const size_t& getNumOfStoredPackets() noexcept {
+            /*! \fn size_t getNumOfStoredPackets()
+                \return the number of completed packets*/
+            size_t getNumOfStoredPackets() noexcept {
                 return mStoredPackets.size();
             }
 
             /*! \fn char* getBuffer()
-                \return a pointer to the buffer. (nullptr if constructor failed.)*/
+                \brief Moves the unparsed bytes to the front, so getBuffer() + getCurrentSize()
+                    is the end of them, and getSize() - getCurrentSize() bytes are free after it.
+                    Use getWritable() for receiving, it does not move anything.
+                \return a pointer to the buffer, to the first unparsed byte. (nullptr if constructor failed.)*/
             char* getBuffer() noexcept {
+                if(mPool != nullptr && mBuffer == nullptr) {
+                    getWritable();
+                }
+                compact();
                 return mBuffer;
             }
 
+            /*! \fn char* getWritable()
+                \return a pointer to the free space after the unparsed bytes, the received
+                    bytes have to be written here before buildPackets()*/
+            char* getWritable() noexcept {
+                if(mPool != nullptr && mBuffer == nullptr) { //the packets are built in the scratch buffer
+                    mBuffer = mPool->getScratch();
+                    mSize = mPool->getScratchSize();
+                    mScratch = true;
+                }
+                return mBuffer + mEnd;
+            }
+
+            /*! \fn size_t getWritableSize()
+                \return the number of bytes which can be written to getWritable()*/
+            size_t getWritableSize() const noexcept {
+                if(mPool != nullptr && mBuffer == nullptr) {
+                    return mPool->getScratchSize();
+                }
+                return mSize - mEnd;
+            }
+
             /*! \fn const size_t& getSize()
-                \return the maximum size of the buffer*/
+                \return the current size of the buffer, it changes only in an elastic buffer*/
             const size_t& getSize() const noexcept {
                 return mSize;
             }
 
 
-            /*! \fn const size_t& getCurrentSize()
+            /*! \fn size_t getEstimate()
+                \return the moving average of the packet sizes of the connection, with the headers*/
+            size_t getEstimate() const noexcept {
+                return mEstimate >> 4;
+            }
+
+            /*! \fn size_t getCurrentSize()
                 \return how many bytes the buffer contain yet.*/
-            const size_t& getCurrentSize() const noexcept {
-                return mCurrentlyStoredBytes;
+            size_t getCurrentSize() const noexcept {
+                return mEnd - mStart;
             }
 
             /*! \fn Packet getPacket()
                 \return the first completed packet*/
             Packet getPacket() noexcept {
-                Packet packet = mStoredPackets.front();
+                Packet packet = std::move(mStoredPackets.front());
                 mStoredPackets.pop();
                 return packet;
             }
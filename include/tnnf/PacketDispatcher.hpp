@@ -0,0 +1,225 @@
+/*! \file PacketDispatcher.hpp
+    \brief Calling the handler of a packet by its type through a flat table.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_PACKETDISPATCHER_HPP
+#define TNNF_PACKETDISPATCHER_HPP
+
+#include <sys/socket.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Packet.hpp"
+#include "PacketBuffer.hpp"
+#include "Socket.hpp"
+#include "tnnf.hpp"
+
+namespace tnnf {
+    /*! \struct PacketRoute
+        \brief A handler of one packet type, made by route().
+        \tparam Type The packet type.
+        \tparam Handler void(Socket&, Packet&)*/
+    template<uint16_t Type, typename Handler>
+    struct PacketRoute {
+        static constexpr uint16_t TYPE = Type;
+        Handler handler;
+    };
+
+    /*! \fn PacketRoute<Type, Handler> route(Handler&& handler)
+        \brief Binds a handler to a packet type at compile time.
+        \param handler A function, lambda or functor, called as handler(sock, packet).
+        \tparam Type The packet type.
+        \return the route for makeDispatcher()*/
+    template<uint16_t Type, typename Handler>
+    PacketRoute<Type, typename std::decay<Handler>::type> route(Handler&& handler) {
+        return PacketRoute<Type, typename std::decay<Handler>::type>{std::forward<Handler>(handler)};
+    }
+
+    // The biggest type of the routes.
+    template<typename... Routes>
+    struct MaxPacketType {
+        static constexpr uint16_t value = 0;
+    };
+
+    template<typename Route, typename... Rest>
+    struct MaxPacketType<Route, Rest...> {
+        static constexpr uint16_t value = Route::TYPE > MaxPacketType<Rest...>::value ? Route::TYPE : MaxPacketType<Rest...>::value;
+    };
+
+    // True if every type has only one route.
+    template<typename... Routes>
+    struct UniquePacketTypes {
+        static constexpr bool value = true;
+    };
+
+    template<typename Route, typename... Rest>
+    struct UniquePacketTypes<Route, Rest...> {
+        template<typename Other>
+        struct Differs {
+            static constexpr bool value = Other::TYPE != Route::TYPE;
+        };
+
+        template<typename... Others>
+        struct AllDiffer {
+            static constexpr bool value = true;
+        };
+
+        template<typename Other, typename... Others>
+        struct AllDiffer<Other, Others...> {
+            static constexpr bool value = Differs<Other>::value && AllDiffer<Others...>::value;
+        };
+
+        static constexpr bool value = AllDiffer<Rest...>::value && UniquePacketTypes<Rest...>::value;
+    };
+
+    /*! \class PacketDispatcher
+        \brief Calls the handler of a packet by its type. The handlers are given at compile time,
+            so every table entry calls its handler directly, and the handler can be inlined into it.
+            The table has an entry for every type up to the biggest one, so use small type numbers.
+
+        Example:
+        \code
+        auto dispatcher = tnnf::makeDispatcher(
+            tnnf::route<0>([](tnnf::Socket& sock, tnnf::Packet& packet) {
+                std::cout << packet.getData() << std::endl;
+            }),
+            tnnf::route<1>([](tnnf::Socket& sock, tnnf::Packet& packet) {
+                std::cout << 5 + atoi(packet.getData().c_str()) << std::endl;
+            })
+        );
+
+        for(auto& sock : readableSockets) {
+            if(!dispatcher.drain(*sock, buffer)) { //the packets are not queued in the buffer
+                selector.remove(*sock);
+            }
+        }
+        \endcode
+        A packet of an unknown type is reported through the common error callback with ERROR_PACKET_UNKNOWN_TYPE.
+        \tparam Routes PacketRoutes, made by route().*/
+    template<typename... Routes>
+    class PacketDispatcher {
+        private:
+            static_assert(UniquePacketTypes<Routes...>::value, "Every packet type can have only one route.");
+
+            typedef void (*Entry)(PacketDispatcher&, Socket&, Packet&);
+            static constexpr size_t TABLE_SIZE = (size_t) MaxPacketType<Routes...>::value + 1;
+
+            // Entry of the route at index I.
+            template<size_t I>
+            static void call(PacketDispatcher& dispatcher, Socket& sock, Packet& packet) {
+                std::get<I>(dispatcher.mRoutes).handler(sock, packet);
+            }
+
+            // Put the entries of the routes from I into the table.
+            template<size_t I>
+            void fill(std::integral_constant<size_t, I>) noexcept {
+                mTable[std::tuple_element<I, std::tuple<Routes...>>::type::TYPE] = &call<I>;
+                fill(std::integral_constant<size_t, I + 1>());
+            }
+
+            void fill(std::integral_constant<size_t, sizeof...(Routes)>) noexcept {}
+
+            std::tuple<Routes...> mRoutes;
+            std::vector<Entry> mTable; //indexed by the type, nullptr without a route. Not inline, it can be big
+
+        protected:
+
+        public:
+            /*! \fn PacketDispatcher(Routes... routes)
+                \brief Constructor. Use makeDispatcher() instead, which deduces the types.
+                \param routes*/
+            explicit PacketDispatcher(Routes... routes) :
+                mRoutes(std::move(routes)...),
+                mTable(TABLE_SIZE, nullptr)
+            {
+                fill(std::integral_constant<size_t, 0>());
+            }
+
+            /*! \fn bool dispatch(Socket& sock, Packet& packet)
+                \brief Calls the handler of the type of the packet.
+                \param sock The socket which received the packet, it is passed to the handler.
+                \param packet
+                \return false if the type does not have a handler*/
+            bool dispatch(Socket& sock, Packet& packet) {
+                uint16_t type = packet.getType();
+
+                if(type >= mTable.size() || mTable[type] == nullptr) {
+                    gCommonErrorFunction(ERROR_PACKET_UNKNOWN_TYPE, "Packet type does not have a handler.");
+                    return false;
+                }
+
+                mTable[type](*this, sock, packet);
+                return true;
+            }
+
+            /*! \fn void dispatch(Socket& sock, PacketBuffer& buffer)
+                \brief Dispatches the packets which are stored in the buffer, for example after receive().
+                \param sock The socket which received the packets.
+                \param buffer*/
+            void dispatch(Socket& sock, PacketBuffer& buffer) {
+                while(buffer.isPacketStored()) {
+                    Packet packet = buffer.getPacket();
+                    dispatch(sock, packet);
+                }
+            }
+
+            /*! \fn bool drain(Socket& sock, PacketBuffer& buffer, const int& flags = 0)
+                \brief Reads a stream socket like Socket::drain(), until the read would block, and dispatches
+                    every packet as soon as it is built, so they are not stored in the buffer.
+                    The buffer keeps only the incomplete packet between the calls.
+                \param sock A stream socket, passed to the handlers.
+                \param buffer
+                \param flags Receiving flags. MSG_DONTWAIT is always added.
+                \return false if the connection hung up or failed, true otherwise*/
+            bool drain(Socket& sock, PacketBuffer& buffer, const int& flags = 0) {
+                bool full = false;
+
+                dispatch(sock, buffer); //stored by an earlier receive()
+
+                if(!sock.drain(buffer, ReadBudget{0, 0}, full, flags, [this, &sock](Packet& packet) {
+                    dispatch(sock, packet);
+                })) {
+                    return false;
+                }
+                if(full) { //an incomplete packet fills the buffer
+                    gCommonErrorFunction(ERROR_PACKETBUFFER_TOO_SMALL, "PacketBuffer is full, the rest of the received bytes stays in the kernel.");
+                }
+                return true;
+            }
+    };
+
+    /*! \fn PacketDispatcher<Routes...> makeDispatcher(Routes... routes)
+        \brief Makes a PacketDispatcher from routes.
+        \param routes The results of route().
+        \return the dispatcher*/
+    template<typename... Routes>
+    PacketDispatcher<Routes...> makeDispatcher(Routes... routes) {
+        return PacketDispatcher<Routes...>(std::move(routes)...);
+    }
+}//tnnf
+
+#endif
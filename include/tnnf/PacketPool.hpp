@@ -0,0 +1,295 @@
+/*! \file PacketPool.hpp
+    \brief Recycling Packets and the memory of their data.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_PACKETPOOL_HPP
+#define TNNF_PACKETPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ObjectPool.hpp"
+#include "Packet.hpp"
+
+namespace tnnf {
+    class PacketPool;
+
+    /*! \struct PacketDeleter
+        \brief Gives a Packet back to its PacketPool, see PooledPacket.*/
+    struct PacketDeleter {
+        PacketPool* pool; //!< the pool of the packet
+
+        void operator()(Packet* packet) const noexcept;
+    };
+
+    /*! \typedef PooledPacket
+        \brief A Packet of a PacketPool, which is given back when it is destroyed.*/
+    typedef std::unique_ptr<Packet, PacketDeleter> PooledPacket;
+
+    /*! \class PacketPool
+        \brief Keeps the released Packets with the memory of their data, so a new Packet
+            does not allocate if a released one has enough capacity.
+
+        The released packets are sorted into size classes by their capacity, from 64 bytes
+        to 64 KiB, and a new packet is taken from the class of its size. The packets and
+        their data are freed only by trim() and the destructor.
+
+        It is not thread safe: use PacketPool::Local(), which is one pool on every thread,
+        and release the packets on the thread where they were made.
+        \code
+        tnnf::PooledPacket packet = tnnf::PacketPool::Local().make(1, data, size);
+        sock.send(*packet);
+        //given back to the pool here
+        \endcode*/
+    class PacketPool {
+        public:
+            static const size_t CLASSES = 6;        //!< number of the size classes
+            static const size_t SMALLEST = 64;      //!< capacity of the smallest class, every class is 4 times bigger
+
+        private:
+            // The class which has enough capacity for size, CLASSES if it is too big for every class.
+            static size_t GetClass(const size_t& size) noexcept {
+                size_t index = 0;
+                while(index < CLASSES && GetClassSize(index) < size) {
+                    index++;
+                }
+                return index;
+            }
+
+            ObjectPool<Packet> mPackets; //every packet, the released ones too
+            std::vector<Packet*> mFree[CLASSES + 1]; //released packets by capacity, the last has less than SMALLEST
+
+        protected:
+
+        public:
+            PacketPool() noexcept {}
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The PooledPackets refer to the pool.*/
+            PacketPool(const PacketPool& other) = delete;
+            PacketPool& operator=(const PacketPool& other) = delete;
+            PacketPool(PacketPool&& other) = delete;
+            PacketPool& operator=(PacketPool&& other) = delete;
+
+            /*! \fn ~PacketPool()
+                \brief Destructor. The made packets has to be released before.*/
+            ~PacketPool() {
+                trim();
+            }
+
+            /*! \fn static PacketPool& Local()
+                \return the pool of the calling thread*/
+            static PacketPool& Local() {
+                thread_local PacketPool pool;
+                return pool;
+            }
+
+            /*! \fn static size_t GetClassSize(const size_t& index)
+                \return the smallest capacity of the packets of a class*/
+            static size_t GetClassSize(const size_t& index) noexcept {
+                return SMALLEST << (2 * index);
+            }
+
+            /*! \fn Packet* acquire(const uint16_t& type, const char* data, const size_t& size)
+                \brief Makes a packet like Packet::assign(). Prefer make(), which releases it.
+                \param type
+                \param data
+                \param size Size of the data.
+                \return the packet, which has to be given back with release()*/
+            Packet* acquire(const uint16_t& type, const char* data, const size_t& size) {
+                size_t index = GetClass(size);
+                Packet* packet = nullptr;
+
+                if(index < CLASSES && !mFree[index].empty()) {
+                    packet = mFree[index].back();
+                    mFree[index].pop_back();
+                }
+                else {
+                    for(auto& i : mFree) { //every packet fits in every list, so release() does not allocate
+                        if(i.capacity() <= mPackets.getSize()) {
+                            i.reserve(2 * mPackets.getSize() + 1);
+                        }
+                    }
+
+                    packet = mPackets.create();
+                    if(index < CLASSES) {
+                        packet->getData().reserve(GetClassSize(index)); //the next user of the class fits too
+                    }
+                }
+
+                packet->assign(type, data, size);
+                return packet;
+            }
+
+            /*! \fn void release(Packet* packet)
+                \brief Gives back a packet of acquire(), it is kept with its data for the next one.
+                \param packet*/
+            void release(Packet* packet) noexcept {
+                size_t capacity = packet->getData().capacity();
+                size_t index = CLASSES;
+
+                for(size_t i = 0; i < CLASSES && GetClassSize(i) <= capacity; i++) { //the biggest class, which it can serve
+                    index = i;
+                }
+
+                mFree[index].push_back(packet); //does not allocate, see acquire()
+            }
+
+            /*! \fn PooledPacket make(const uint16_t& type, const char* data, const size_t& size)
+                \brief Makes a packet like Packet::assign().
+                \param type
+                \param data
+                \param size Size of the data.
+                \return the packet, it is given back to the pool when it is destroyed*/
+            PooledPacket make(const uint16_t& type, const char* data, const size_t& size) {
+                return PooledPacket(acquire(type, data, size), PacketDeleter{this});
+            }
+
+            /*! \fn PooledPacket make(const uint16_t& type, const std::string& data)
+                \brief Makes a packet like the constructor of Packet.
+                \param type
+                \param data
+                \return the packet, it is given back to the pool when it is destroyed*/
+            PooledPacket make(const uint16_t& type, const std::string& data) {
+                return make(type, data.data(), data.size());
+            }
+
+            /*! \fn PooledPacket make(const PacketView& view)
+                \brief Copies a received packet out of its PacketBuffer.
+                \param view
+                \return the packet, it is given back to the pool when it is destroyed*/
+            PooledPacket make(const PacketView& view) {
+                return make(view.type, view.data, view.size);
+            }
+
+            /*! \fn void trim()
+                \brief Frees the released packets and their data, for example after a traffic peak.*/
+            void trim() noexcept {
+                for(auto& i : mFree) {
+                    for(auto& j : i) {
+                        mPackets.destroy(j);
+                    }
+                    i.clear();
+                    i.shrink_to_fit();
+                }
+            }
+
+            /*! \fn size_t getSize()
+                \return the number of the packets which are not released*/
+            size_t getSize() const noexcept {
+                size_t released = 0;
+                for(auto& i : mFree) {
+                    released += i.size();
+                }
+                return mPackets.getSize() - released;
+            }
+    };
+
+    inline void PacketDeleter::operator()(Packet* packet) const noexcept {
+        pool->release(packet);
+    }
+
+    /*! \class PacketArena
+        \brief Holds the packets of one loop iteration, and releases all of them at once with reset().
+
+        Example:
+        \code
+        tnnf::PacketArena arena;
+
+        while(running) {
+            selector.update(); //the handlers use arena.make(view), and keep the references
+            handleAll(); //until the end of the iteration
+            arena.reset();
+        }
+        \endcode
+        It is not thread safe.*/
+    class PacketArena {
+        private:
+            PacketPool& mPool;
+            std::vector<Packet*> mPackets; //made since the last reset()
+
+        protected:
+
+        public:
+            /*! \fn PacketArena(PacketPool& pool = PacketPool::Local())
+                \brief Constructor.
+                \param pool The packets are taken from here. It has to live longer than the arena.*/
+            explicit PacketArena(PacketPool& pool = PacketPool::Local()) noexcept :
+                mPool(pool)
+            {}
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted.*/
+            PacketArena(const PacketArena& other) = delete;
+            PacketArena& operator=(const PacketArena& other) = delete;
+
+            /*! \fn ~PacketArena()
+                \brief Destructor. Releases the packets.*/
+            ~PacketArena() {
+                reset();
+            }
+
+            /*! \fn Packet& make(const uint16_t& type, const char* data, const size_t& size)
+                \brief Makes a packet like Packet::assign().
+                \param type
+                \param data
+                \param size Size of the data.
+                \return the packet, which is valid until reset()*/
+            Packet& make(const uint16_t& type, const char* data, const size_t& size) {
+                if(mPackets.size() == mPackets.capacity()) { //push_back() does not throw after acquire()
+                    mPackets.reserve(2 * mPackets.capacity() + 1);
+                }
+                Packet* packet = mPool.acquire(type, data, size);
+
+                mPackets.push_back(packet);
+                return *packet;
+            }
+
+            /*! \fn Packet& make(const PacketView& view)
+                \brief Copies a received packet out of its PacketBuffer.
+                \param view
+                \return the packet, which is valid until reset()*/
+            Packet& make(const PacketView& view) {
+                return make(view.type, view.data, view.size);
+            }
+
+            /*! \fn void reset()
+                \brief Gives back every packet to the pool. The references of make() are invalid after it.*/
+            void reset() {
+                for(auto& i : mPackets) {
+                    mPool.release(i);
+                }
+                mPackets.clear();
+            }
+
+            /*! \fn size_t getSize()
+                \return the number of the packets since the last reset()*/
+            size_t getSize() const noexcept {
+                return mPackets.size();
+            }
+    };
+}//tnnf
+
+#endif
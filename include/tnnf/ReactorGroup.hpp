@@ -0,0 +1,431 @@
+/*! \file ReactorGroup.hpp
+    \brief Event loops on multiple threads, and distributing the accepted connections between them.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_REACTORGROUP_HPP
+#define TNNF_REACTORGROUP_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EpollSelector.hpp"
+#include "ListenerSocket.hpp"
+#include "TcpSocket.hpp"
+#include "tnnf.hpp"
+
+namespace tnnf {
+    class Reactor;
+
+    typedef std::function<void(Reactor&, Socket&)> ReactorHandler; //called for every readable socket
+
+    /*! \class Reactor
+        \brief One event loop on its own thread. It owns an EpollSelector, and calls
+            the handler for every readable socket.
+
+        Sockets can be given to it from any thread with add(), but everything else
+        has to be called from the handler, on the thread of the Reactor.*/
+    class Reactor {
+        private:
+            // True on the threads of the Reactors.
+            static bool& getLoopThread() noexcept {
+                thread_local bool loopThread = false;
+                return loopThread;
+            }
+
+            // The loop of the thread.
+            void run() {
+                getLoopThread() = true;
+
+                while(mRunning.load(std::memory_order_acquire)) {
+                    mSelector.update(); //adds the posted sockets too
+
+                    for(auto& i : mReadable) {
+                        if(mListener && *i == *mListener) {
+                            mAccepted.clear();
+                            mListener->acceptAll(mAccepted, 64, SOCK_CLOEXEC); //the rest is reported again, the handlers get blocking sockets
+
+                            for(auto& sock : mAccepted) {
+                                mSelector.add(std::move(sock));
+                            }
+                            mLoad.fetch_add(mAccepted.size(), std::memory_order_relaxed);
+                        }
+                        else {
+                            mHandler(*this, *i);
+                        }
+                    }
+                }
+            }
+
+            // True on the thread of this Reactor.
+            bool isOwnThread() const noexcept {
+                return mThread.joinable() && mThread.get_id() == std::this_thread::get_id();
+            }
+
+            // Wait for a stopped thread. A thread can not join itself, it is detached.
+            void join() {
+                if(isOwnThread()) {
+                    mThread.detach();
+                }
+                else if(mThread.joinable()) {
+                    mThread.join();
+                }
+            }
+
+            EpollSelector mSelector;
+            std::vector<Socket*> mReadable; //filled by mSelector
+            ReactorHandler mHandler;
+            std::atomic<size_t> mLoad; //number of sockets
+            std::atomic<bool> mRunning;
+            std::thread mThread;
+            std::unique_ptr<ListenerSocket> mListener; //own listener of listen()
+            std::vector<TcpSocket> mAccepted; //reused by the accepting
+
+        protected:
+
+        public:
+            /*! \fn Reactor(const ReactorHandler& handler)
+                \brief Constructor. The thread is started by start().
+                \param handler Called for every readable socket, on the thread of the Reactor.*/
+            explicit Reactor(const ReactorHandler& handler) :
+                mSelector(&mReadable, nullptr, nullptr),
+                mHandler(handler),
+                mLoad(0),
+                mRunning(false)
+            {
+                mSelector.setTimeout(-1, 0);
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The thread refers to the Reactor.*/
+            Reactor(const Reactor& other) = delete;
+            Reactor& operator=(const Reactor& other) = delete;
+            Reactor(Reactor&& other) = delete;
+            Reactor& operator=(Reactor&& other) = delete;
+
+            /*! \fn ~Reactor()
+                \brief Destructor. Stops the thread and waits for it, even if it was stopped on a
+                    loop thread. Do not destroy a Reactor from its own handler: its thread is detached
+                    then, but the loop would still use the Reactor.*/
+            ~Reactor() {
+                stop();
+                join();
+            }
+
+            /*! \fn void start()
+                \brief Starts the thread of the loop. After a stop() on a loop thread the finished
+                    thread is joined first. From its own handler it only cancels the stop().*/
+            void start() {
+                if(isOwnThread()) { //the loop has not returned yet, it goes on
+                    mRunning.store(true, std::memory_order_release);
+                    return;
+                }
+                if(mRunning.load(std::memory_order_acquire)) {
+                    return;
+                }
+
+                join();
+                mRunning.store(true, std::memory_order_release);
+                mThread = std::thread(&Reactor::run, this);
+            }
+
+            /*! \fn void stop()
+                \brief Stops the loop, and waits for the thread. On the thread of a Reactor, for example
+                    from a handler, it does not wait, then the thread is joined by the next start(),
+                    or by stop() or the destructor on another thread.*/
+            void stop() {
+                mRunning.store(false, std::memory_order_release);
+                mSelector.wakeup();
+
+                if(mThread.joinable() && !IsLoopThread()) {
+                    mThread.join();
+                }
+            }
+
+            /*! \fn static bool IsLoopThread()
+                \return true if it is called on the thread of a Reactor*/
+            static bool IsLoopThread() noexcept {
+                return getLoopThread();
+            }
+
+            /*! \fn void listen(const Address& address, unsigned int queueLength)
+                \brief Makes a ListenerSocket with SO_REUSEPORT, and accepts the connections
+                    of it on the thread of the Reactor. Call it before start().
+                \param address You have to specify the port too.
+                \param queueLength the length of the queue*/
+            void listen(const Address& address, unsigned int queueLength) {
+                mListener.reset(new ListenerSocket(address, queueLength, true));
+                mListener->setBlocking(false);
+                mSelector.add(*mListener);
+            }
+
+            /*! \fn void add(TcpSocket& sock)
+                \brief Hands a socket over to the loop without a lock. It can be called from any thread.
+                \param sock It will be watched from the next iteration.*/
+            void add(TcpSocket& sock) {
+                mLoad.fetch_add(1, std::memory_order_relaxed);
+
+                mSelector.post([this, sock]() mutable {
+                    mSelector.add(std::move(sock));
+                });
+            }
+
+            /*! \fn void remove(Socket& sock)
+                \brief Removes a socket from the loop. Call it only from the handler,
+                    the reference to the socket is invalid after it.
+                \param sock*/
+            void remove(Socket& sock) noexcept {
+                mSelector.remove(sock);
+                mLoad.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            /*! \fn EpollSelector& getSelector()
+                \return the selector of the loop. Use it only on the thread of the Reactor.*/
+            EpollSelector& getSelector() noexcept {
+                return mSelector;
+            }
+
+            /*! \fn size_t getLoad()
+                \return the number of sockets which were added and not removed*/
+            size_t getLoad() const noexcept {
+                return mLoad.load(std::memory_order_relaxed);
+            }
+    };
+
+    /*! \class ReactorGroup
+        \brief Runs one Reactor on every core, and distributes the accepted connections
+            between them, round-robin or to the least loaded one.
+
+        Example:
+        \code
+        tnnf::ListenerSocket listener(tnnf::Address("127.0.0.1", 25565), 128);
+
+        tnnf::ReactorGroup group([](tnnf::Reactor& reactor, tnnf::Socket& sock) {
+            thread_local std::map<int, tnnf::PacketBuffer> buffers; //one buffer for every connection
+            tnnf::PacketBuffer& buffer = buffers[sock.getSocket()];
+
+            if(!sock.drain(buffer)) { //hang up
+                buffers.erase(sock.getSocket());
+                reactor.remove(sock);
+                return;
+            }
+
+            while(buffer.isPacketStored()) {
+                reactor.getSelector().send(sock, buffer.getPacket()); //does not block the loop
+            }
+        });
+
+        group.start();
+        group.serve(listener); //blocks until group.stop() is called
+        \endcode
+        Instead of serve() every Reactor can have its own listener on the same port,
+        then the kernel distributes the connections and there is no hand over between threads:
+        \code
+        group.listen(tnnf::Address("127.0.0.1", 25565), 128);
+        group.start();
+        \endcode
+        The handler is called on several threads at the same time, so the socket error
+        callback has to be thread safe too.*/
+    class ReactorGroup {
+        public:
+            //! \enum Distribution How the accepted connections are distributed.
+            enum Distribution {
+                ROUND_ROBIN,    //!< one after the other
+                LEAST_LOADED    //!< to the Reactor with the least sockets
+            };
+
+        private:
+            std::vector<std::unique_ptr<Reactor>> mReactors;
+            Distribution mDistribution;
+            size_t mNext; //next Reactor for ROUND_ROBIN
+            std::atomic<bool> mServing;
+            std::mutex mAcceptorMutex; //guards mAcceptor and mStopRequested
+            bool mStopRequested; //stop() was called after start(), so serve() returns at once
+            EpollSelector* mAcceptor; //the selector of serve(), while it runs
+
+        protected:
+
+        public:
+            /*! \fn ReactorGroup(const ReactorHandler& handler, size_t count = 0, Distribution distribution = ROUND_ROBIN)
+                \brief Constructor.
+                \param handler Called for every readable socket, on the thread of its Reactor.
+                \param count Number of Reactors. 0 means one for every core.
+                \param distribution*/
+            ReactorGroup(const ReactorHandler& handler, size_t count = 0, Distribution distribution = ROUND_ROBIN) :
+                mDistribution(distribution),
+                mNext(0),
+                mServing(false),
+                mStopRequested(false),
+                mAcceptor(nullptr)
+            {
+                if(count == 0) {
+                    count = std::max(1u, std::thread::hardware_concurrency());
+                }
+
+                for(size_t i = 0; i < count; i++) {
+                    mReactors.emplace_back(new Reactor(handler));
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted.*/
+            ReactorGroup(const ReactorGroup& other) = delete;
+            ReactorGroup& operator=(const ReactorGroup& other) = delete;
+            ReactorGroup(ReactorGroup&& other) = delete;
+            ReactorGroup& operator=(ReactorGroup&& other) = delete;
+
+            /*! \fn ~ReactorGroup()
+                \brief Destructor. Stops all threads.*/
+            ~ReactorGroup() {
+                stop();
+            }
+
+            /*! \fn void start()
+                \brief Starts the threads of the Reactors.*/
+            void start() {
+                {
+                    std::lock_guard<std::mutex> lock(mAcceptorMutex);
+                    mStopRequested = false;
+                }
+
+                for(auto& i : mReactors) {
+                    i->start();
+                }
+            }
+
+            /*! \fn void stop()
+                \brief Stops serve() and the threads of the Reactors. It can be called from any thread,
+                    for example from a handler, then it does not wait for the threads of the Reactors.
+                    If serve() is not running yet, it returns at once when it is called.*/
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock(mAcceptorMutex);
+                    mStopRequested = true;
+
+                    if(mServing.exchange(false) && mAcceptor != nullptr) {
+                        mAcceptor->wakeup();
+                        return; //serve() stops the Reactors on its own thread
+                    }
+                }
+
+                for(auto& i : mReactors) {
+                    i->stop();
+                }
+            }
+
+            /*! \fn void dispatch(TcpSocket& sock)
+                \brief Hands a connection over to one of the Reactors.
+                    Call it always from the same thread.
+                \param sock*/
+            void dispatch(TcpSocket& sock) {
+                Reactor* target = mReactors[0].get();
+
+                if(mDistribution == ROUND_ROBIN) {
+                    target = mReactors[mNext].get();
+                    mNext = (mNext + 1) % mReactors.size();
+                }
+                else {
+                    for(auto& i : mReactors) {
+                        if(i->getLoad() < target->getLoad()) {
+                            target = i.get();
+                        }
+                    }
+                }
+
+                target->add(sock);
+            }
+
+            /*! \fn void listen(const Address& address, unsigned int queueLength)
+                \brief Makes a ListenerSocket with SO_REUSEPORT in every Reactor on the same address,
+                    which accepts on the thread of the Reactor. Call it before start().
+                \param address You have to specify the port too.
+                \param queueLength the length of the queue of every listener*/
+            void listen(const Address& address, unsigned int queueLength) {
+                for(auto& i : mReactors) {
+                    i->listen(address, queueLength);
+                }
+            }
+
+            /*! \fn void serve(ListenerSocket& listener)
+                \brief Accepts connections on the calling thread and dispatches them,
+                    until stop() is called. Stops the Reactors at the end.
+                \param listener It is made non-blocking, so the waiting connections are accepted in batches.*/
+            void serve(ListenerSocket& listener) {
+                std::vector<Socket*> readable;
+                std::vector<TcpSocket> accepted; //reused by the accepting
+                EpollSelector acceptor(&readable, nullptr, nullptr);
+
+                listener.setBlocking(false);
+
+                acceptor.setTimeout(-1, 0);
+                acceptor.add(listener);
+
+                {
+                    std::lock_guard<std::mutex> lock(mAcceptorMutex);
+
+                    if(!mStopRequested) {
+                        mAcceptor = &acceptor;
+                        mServing.store(true);
+                    }
+                }
+
+                while(mServing.load()) {
+                    acceptor.update();
+
+                    if(!readable.empty() && mServing.load()) {
+                        accepted.clear();
+                        listener.acceptAll(accepted, 0, SOCK_CLOEXEC);
+
+                        for(auto& sock : accepted) {
+                            dispatch(sock);
+                        }
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mAcceptorMutex);
+                    mAcceptor = nullptr;
+                }
+
+                for(auto& i : mReactors) {
+                    i->stop();
+                }
+            }
+
+            /*! \fn size_t getCount()
+                \return the number of Reactors*/
+            size_t getCount() const noexcept {
+                return mReactors.size();
+            }
+
+            /*! \fn Reactor& getReactor(const size_t& index)
+                \return the Reactor at the given index*/
+            Reactor& getReactor(const size_t& index) noexcept {
+                return *mReactors[index];
+            }
+    };
+}//tnnf
+
+#endif
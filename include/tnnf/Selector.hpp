@@ -26,18 +26,31 @@ freely, subject to the following restrictions:
 
 #include <vector>
 
+#include "ObjectPool.hpp"
+#include "SelectorBackend.hpp"
 #include "Socket.hpp"
+#include "SocketTable.hpp"
+#include "StoredSocket.hpp"
 #include "tnnf.hpp"
 
 namespace tnnf {
-    /*! \class Selector
+    /*! \class BasicSelector
         \brief A class that stores sockets and check their state.
 
         You have to add your sockets (which is inherited from class Socket)
         to the selector and frequently call the update() method to keep their
         status up to date. The Selector is watching which sockets has data, which
-        can be written and which has an exception.*/
-    class Selector {
+        can be written and which has an exception.
+
+        The system call is chosen at compile time by the backend, so the loop does not
+        have virtual calls. tnnf::Selector uses select(), the others have the same interface:
+        \code
+        tnnf::BasicSelector<tnnf::PollBackend> selector(&readableSockets, nullptr, nullptr);
+        tnnf::BasicSelector<tnnf::EpollBackend> selector(&readableSockets, nullptr, nullptr);
+        \endcode
+        \tparam Backend SelectBackend, PollBackend or EpollBackend (tnnf/SelectorBackend.hpp)*/
+    template<typename Backend>
+    class BasicSelector {
         private:
             // Clear all user provided arrays.
             void clearTemp() noexcept {
@@ -52,84 +65,83 @@ namespace tnnf {
                 }
             }
 
-            std::vector<Socket*> mSockets; //all sockets
+            // Pass the events of the set arrays to the backend.
+            void updateInterest() noexcept {
+                uint32_t interest = 0;
+
+                if(mReadable != nullptr) {
+                    interest |= SELECTOR_READABLE;
+                }
+                if(mWritable != nullptr) {
+                    interest |= SELECTOR_WRITABLE;
+                }
+                if(mFaulty != nullptr) {
+                    interest |= SELECTOR_FAULTY;
+                }
+                mBackend.setInterest(interest, mSockets.getDescriptors());
+            }
+
+            // Take a place for a socket. nullptr if it is already added.
+            StoredSocket* allocate(const int& fd) noexcept {
+                if(fd < 0 || mSockets.find(fd) != nullptr) {
+                    return nullptr;
+                }
+                if(!mBackend.add(fd)) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not add a socket.");
+                    return nullptr;
+                }
+
+                StoredSocket* stored = mPool.create();
+                mSockets.insert(fd, stored);
+                return stored;
+            }
+
+            ObjectPool<StoredSocket> mPool; //memory of the sockets
+            SocketTable<StoredSocket*> mSockets; //all sockets, indexed by the file descriptor
+            Backend mBackend; //the system call
             std::vector<Socket*>* mWritable, *mReadable, *mFaulty; //pointers to user provided arrays
-            fd_set mFdSockets, mFdWritable, mFdReadable, mFdFaulty;
-            fd_set* mFdWritablePointer, *mFdReadablePointer, *mFdFaultyPointer; //pointers to fd_set variables
             timeval* mTimeout; //this store the selector timeout
-            int mSocketsMax; //store the largest socket number
 
         protected:
 
         public:
-            /*! \fn Selector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty)
+            /*! \fn BasicSelector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty)
                 \brief Constructor.
                 \param readable Array for the pointers of the readable sockets.
                 \param writable Array for the pointers of the readable sockets.
                 \param faulty Array for the pointers to the sockets which got exception.*/
-            Selector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty) noexcept :
-                mWritable(nullptr),
-                mReadable(nullptr),
-                mFaulty(nullptr),
-                mFdWritablePointer(nullptr),
-                mFdReadablePointer(nullptr),
-                mFdFaultyPointer(nullptr),
-                mTimeout(nullptr),
-                mSocketsMax(0)
+            BasicSelector(std::vector<Socket*>* readable, std::vector<Socket*>* writable, std::vector<Socket*>* faulty) noexcept :
+                mWritable(writable),
+                mReadable(readable),
+                mFaulty(faulty),
+                mTimeout(nullptr)
             {
-                FD_ZERO(&mFdSockets);
-                FD_ZERO(&mFdWritable);
-                FD_ZERO(&mFdReadable);
-                FD_ZERO(&mFdFaulty);
-
                 mTimeout = new timeval;
                 mTimeout->tv_sec = 0;
                 mTimeout->tv_usec = 0;
 
-                if(writable == nullptr) {
-                    mFdWritablePointer = nullptr;
-                    mWritable = nullptr;
-                }
-                else {
-                    setWritable(writable);
-                }
-
-                if(readable == nullptr) {
-                    mFdReadablePointer = nullptr;
-                    mReadable = nullptr;
-                }
-                else {
-                    setReadable(readable);
-                }
-
-                if(faulty == nullptr) {
-                    mFdFaultyPointer = nullptr;
-                    mFaulty = nullptr;
-                }
-                else {
-                    setFaulty(faulty);
-                }
+                updateInterest();
             }
 
             /*! \fn Copy and Move constructors and assignments
                 \brief Copy methods deleted. Moving methods are available.*/
-            Selector(const Selector& other) = delete;
-            Selector& operator=(const Selector& other) = delete;
-            Selector(Selector&& other) = default;
-            Selector& operator=(Selector&& other) = default;
+            BasicSelector(const BasicSelector& other) = delete;
+            BasicSelector& operator=(const BasicSelector& other) = delete;
+            BasicSelector(BasicSelector&& other) = default;
+            BasicSelector& operator=(BasicSelector&& other) = default;
 
-            /*! \fn void swap(Selector& other)
+            /*! \fn void swap(BasicSelector& other)
                 \brief Swap the references between two Selector
                 \param other Another Selector*/
-            void swap(Selector& other) noexcept {
-                Selector temp = std::move(*this);
+            void swap(BasicSelector& other) noexcept {
+                BasicSelector temp = std::move(*this);
                 *this = std::move(other);
                 other = std::move(temp);
             }
 
-            /*! \fn ~Selector()
+            /*! \fn ~BasicSelector()
                 \brief Destructor. All sockets will be unwatched and destroyed if it is necessary.*/
-            ~Selector() {
+            ~BasicSelector() {
                 removeAll();
                 delete mTimeout;
             }
@@ -138,14 +150,11 @@ namespace tnnf {
                 \brief Get the state of the sockets and fill the user provided arrays.
                     If the selector failed, errno set to indicate the error.*/
             void update() {
-                if(mFdReadablePointer != nullptr || mFdWritablePointer != nullptr || mFdFaultyPointer != nullptr) {
-                    mFdWritable = mFdSockets;
-                    mFdReadable = mFdSockets;
-                    mFdFaulty = mFdSockets;
+                if(mReadable != nullptr || mWritable != nullptr || mFaulty != nullptr) {
+                    clearTemp();
 
                     int selectError;
-                    if((selectError = select(mSocketsMax+1, mFdReadablePointer, mFdWritablePointer, mFdFaultyPointer, mTimeout)) <= 0) {
-                        clearTemp();
+                    if((selectError = mBackend.wait(mTimeout)) <= 0) {
                         if(selectError == 0) {
                             gCommonErrorFunction(ERROR_SELECTOR_TIMEOUT, "Selector timed out.");
                             return;
@@ -156,35 +165,19 @@ namespace tnnf {
                         }
                     }
                     else {
-                        if(mFdWritablePointer != nullptr) {
-                            mWritable->clear();
+                        mBackend.forEachReady(mSockets.getDescriptors(), [this](const int& fd, const uint32_t& events) {
+                            Socket* sock = (*mSockets.find(fd))->get();
 
-                            for(auto& i : mSockets) {
-                                if(FD_ISSET(i->getSocket(), mFdWritablePointer)) {
-                                    mWritable->push_back(i);
-                                }
+                            if(events & SELECTOR_WRITABLE) {
+                                mWritable->push_back(sock);
                             }
-                        }
-
-                        if(mFdReadablePointer != nullptr) {
-                            mReadable->clear();
-
-                            for(auto& i : mSockets) {
-                                if(FD_ISSET(i->getSocket(), mFdReadablePointer)) {
-                                    mReadable->push_back(i);
-                                }
+                            if(events & SELECTOR_READABLE) {
+                                mReadable->push_back(sock);
                             }
-                        }
-
-                        if(mFdFaultyPointer != nullptr) {
-                            mFaulty->clear();
-
-                            for(auto& i : mSockets) {
-                                if(FD_ISSET(i->getSocket(), mFdFaultyPointer)) {
-                                    mFaulty->push_back(i);
-                                }
+                            if(events & SELECTOR_FAULTY) {
+                                mFaulty->push_back(sock);
                             }
-                        }
+                        });
                     }
                 }
                 else {
@@ -194,7 +187,8 @@ namespace tnnf {
             }
 
             /*! \fn void add(const socketType& sock)
-                \brief Adds a socket to the Selector.
+                \brief Adds a socket to the Selector. It is copied into a pooled storage,
+                    so it does not allocate when a socket was removed before.
 
                 You can use it without the template parameter:
                 \code
@@ -205,11 +199,38 @@ namespace tnnf {
                 \tparam SocketType The type of the socket*/
             template<typename SocketType>
             void add(SocketType& sock) noexcept {
-                FD_SET(sock.getSocket(), &mFdSockets);
-                mSockets.push_back(new SocketType(sock));
+                StoredSocket* stored = allocate(sock.getSocket());
+
+                if(stored != nullptr) {
+                    stored->store<SocketType>(sock);
+                }
+            }
 
-                if(sock.getSocket() > mSocketsMax) {
-                    mSocketsMax = sock.getSocket();
+            /*! \fn void add(socketType&& sock)
+                \brief Adds a socket to the Selector by moving it in, so the reference
+                    counter of the file descriptor is not changed:
+                \code
+                selector.add(listener.accept());
+                \endcode
+                \param sock The socket which will be stored.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType&& sock) noexcept {
+                StoredSocket* stored = allocate(sock.getSocket());
+
+                if(stored != nullptr) {
+                    stored->store<SocketType>(std::move(sock));
+                }
+            }
+
+            /*! \fn void watch(Socket& sock)
+                \brief Adds a socket without storing a copy. The reported pointers point to sock.
+                \param sock It has to live until it is removed from the Selector.*/
+            void watch(Socket& sock) noexcept {
+                StoredSocket* stored = allocate(sock.getSocket());
+
+                if(stored != nullptr) {
+                    stored->watch(sock);
                 }
             }
 
@@ -217,40 +238,26 @@ namespace tnnf {
                 \brief Removes a socket. If the socket does not have more reference, it will be destroyed.
                 \param sock The socket which will be removed.*/
             void remove(Socket& sock) noexcept {
-                FD_CLR(sock.getSocket(), &mFdSockets);
-                for(auto i = mSockets.begin(); i != mSockets.end(); i++) {
-                    if(**i == sock) {
-                        if((*i)->getSocket() == mSocketsMax) {
-                            mSocketsMax = 0;
-                        }
-                        delete *i;
-                        mSockets.erase(i);
-                        break;
-                    }
-                }
+                int fd = sock.getSocket();
+                StoredSocket** stored = mSockets.find(fd);
 
-                mSockets.shrink_to_fit();
-
-                if(mSocketsMax == 0) {
-                    for(auto& i : mSockets) {
-                        if(i->getSocket() > mSocketsMax) {
-                            mSocketsMax = i->getSocket();
-                        }
-                    }
+                if(stored == nullptr) {
+                    return;
                 }
+
+                mBackend.remove(fd);
+                mPool.destroy(*stored);
+                mSockets.erase(fd);
             }
 
             /*! \fn void removeAll()
                 \brief Removes all socket from the selector.*/
             void removeAll() noexcept {
-                FD_ZERO(&mFdSockets);
-                FD_ZERO(&mFdWritable);
-                FD_ZERO(&mFdReadable);
-                FD_ZERO(&mFdFaulty);
                 clearTemp();
 
-                for(auto& i : mSockets) {
-                    delete i;
+                for(auto& i : mSockets.getDescriptors()) {
+                    mBackend.remove(i);
+                    mPool.destroy(*mSockets.find(i));
                 }
                 mSockets.clear();
             }
@@ -259,28 +266,16 @@ namespace tnnf {
                 \brief You can specify the array where the references to writable sockets will be stored.
                 \param array*/
             void setWritable(std::vector<Socket*>* array) noexcept {
-                if(array == nullptr) {
-                    mWritable = nullptr;
-                    mFdWritablePointer = nullptr;
-                }
-                else {
-                    mWritable = array;
-                    mFdWritablePointer = &mFdWritable;
-                }
+                mWritable = array;
+                updateInterest();
             }
 
             /*! \fn void setReadable(std::vector<Socket*>* array)
                 \brief You can specify the array where the references to readable sockets will be stored.
                 \param array*/
             void setReadable(std::vector<Socket*>* array) noexcept {
-                if(array == nullptr) {
-                    mReadable = nullptr;
-                    mFdReadablePointer = nullptr;
-                }
-                else {
-                    mReadable = array;
-                    mFdReadablePointer = &mFdReadable;
-                }
+                mReadable = array;
+                updateInterest();
             }
 
             /*! \fn void setFaulty(std::vector<Socket*>* array)
@@ -288,14 +283,8 @@ namespace tnnf {
                 that sockets which got exceptions.
                 \param array*/
             void setFaulty(std::vector<Socket*>* array) noexcept {
-                if(array == nullptr) {
-                    mFaulty = nullptr;
-                    mFdFaultyPointer = nullptr;
-                }
-                else {
-                    mFaulty = array;
-                    mFdFaultyPointer = &mFdFaulty;
-                }
+                mFaulty = array;
+                updateInterest();
             }
 
             /*! \fn void setTimeout(const timeval& timeout)
@@ -325,13 +314,34 @@ namespace tnnf {
                 \return The array which contains the references to the sockets.*/
             std::vector<Socket*> getAll() noexcept {
                 std::vector<Socket*> temp;
+                temp.reserve(mSockets.getSize());
 
-                for(auto& i : mSockets) {
-                    temp.push_back(i);
+                for(auto& i : mSockets.getDescriptors()) {
+                    temp.push_back((*mSockets.find(i))->get());
                 }
                 return temp;
             }
+
+            /*! \fn SocketHandle getHandle(Socket& sock)
+                \brief A handle identifies a socket of the Selector without a pointer.
+                    It does not find a later socket, which got the same file descriptor.
+                \param sock A stored socket.
+                \return the handle, 0 if the socket is not stored*/
+            SocketHandle getHandle(Socket& sock) const noexcept {
+                return mSockets.getHandle(sock.getSocket());
+            }
+
+            /*! \fn Socket* find(const SocketHandle& handle)
+                \brief Finds a stored socket in constant time.
+                \param handle The result of getHandle().
+                \return the stored socket, nullptr if it was removed*/
+            Socket* find(const SocketHandle& handle) noexcept {
+                StoredSocket** stored = mSockets.find(handle);
+                return stored == nullptr ? nullptr : (*stored)->get();
+            }
     };
+
+    typedef BasicSelector<SelectBackend> Selector; //!< the Selector with select()
 }//tnnf
 
 #endif
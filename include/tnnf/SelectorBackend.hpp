@@ -0,0 +1,424 @@
+/*! \file SelectorBackend.hpp
+    \brief The readiness backends of BasicSelector: select, poll and epoll.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef TNNF_SELECTORBACKEND_HPP
+#define TNNF_SELECTORBACKEND_HPP
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "tnnf.hpp"
+
+namespace tnnf {
+    const uint32_t SELECTOR_READABLE = 1;   //! \var const uint32_t SELECTOR_READABLE
+    const uint32_t SELECTOR_WRITABLE = 2;   //! \var const uint32_t SELECTOR_WRITABLE
+    const uint32_t SELECTOR_FAULTY = 4;     //! \var const uint32_t SELECTOR_FAULTY
+
+    /*! \class SelectBackend
+        \brief The backend of BasicSelector with select(). It works everywhere,
+            but only with descriptors below FD_SETSIZE, and every wait copies the whole set.
+
+        A backend is a policy of BasicSelector, chosen at compile time, so it is not virtual.
+        Every backend has the same methods:
+        \code
+            bool add(const int& fd)
+            void remove(const int& fd)
+            void setInterest(const uint32_t& interest, const std::vector<int>& descriptors)
+            int wait(const timeval* timeout)
+            void forEachReady(const std::vector<int>& descriptors, Function&& function) //function(fd, events)
+        \endcode
+        The interest and the events are the SELECTOR_* flags. Hang up is reported as readable.*/
+    class SelectBackend {
+        private:
+            fd_set mFdSockets, mFdWritable, mFdReadable, mFdFaulty;
+            uint32_t mInterest; //SELECTOR_* flags
+            int mSocketsMax; //store the largest socket number
+
+        protected:
+
+        public:
+            SelectBackend() noexcept :
+                mInterest(0),
+                mSocketsMax(0)
+            {
+                FD_ZERO(&mFdSockets);
+                FD_ZERO(&mFdWritable);
+                FD_ZERO(&mFdReadable);
+                FD_ZERO(&mFdFaulty);
+            }
+
+            /*! \fn bool add(const int& fd)
+                \param fd
+                \return false if the descriptor can not be put into an fd_set*/
+            bool add(const int& fd) noexcept {
+                if(fd >= FD_SETSIZE) {
+                    return false;
+                }
+
+                FD_SET(fd, &mFdSockets);
+                if(fd > mSocketsMax) {
+                    mSocketsMax = fd;
+                }
+                return true;
+            }
+
+            /*! \fn void remove(const int& fd)
+                \param fd*/
+            void remove(const int& fd) noexcept {
+                FD_CLR(fd, &mFdSockets);
+                FD_CLR(fd, &mFdWritable);
+                FD_CLR(fd, &mFdReadable);
+                FD_CLR(fd, &mFdFaulty);
+
+                while(mSocketsMax > 0 && !FD_ISSET(mSocketsMax, &mFdSockets)) { //the next largest descriptor
+                    mSocketsMax--;
+                }
+            }
+
+            /*! \fn void setInterest(const uint32_t& interest, const std::vector<int>& descriptors)
+                \param interest SELECTOR_* flags of every socket.
+                \param descriptors not used*/
+            void setInterest(const uint32_t& interest, const std::vector<int>& /*descriptors*/) noexcept {
+                mInterest = interest;
+            }
+
+            /*! \fn int wait(const timeval* timeout)
+                \param timeout nullptr waits until an event arrives.
+                \return the number of the ready sockets, 0 on timeout, -1 on error*/
+            int wait(const timeval* timeout) noexcept {
+                timeval remaining; //select() changes it
+                if(timeout != nullptr) {
+                    remaining = *timeout;
+                }
+
+                mFdWritable = mFdSockets;
+                mFdReadable = mFdSockets;
+                mFdFaulty = mFdSockets;
+
+                return select(mSocketsMax + 1,
+                    (mInterest & SELECTOR_READABLE) ? &mFdReadable : nullptr,
+                    (mInterest & SELECTOR_WRITABLE) ? &mFdWritable : nullptr,
+                    (mInterest & SELECTOR_FAULTY) ? &mFdFaulty : nullptr,
+                    timeout != nullptr ? &remaining : nullptr);
+            }
+
+            /*! \fn void forEachReady(const std::vector<int>& descriptors, Function&& function)
+                \brief Calls the function with the ready sockets of the last wait(), in the order of the descriptors.
+                \param descriptors All added descriptors.
+                \param function function(fd, events)
+                \tparam Function void(int, uint32_t)*/
+            template<typename Function>
+            void forEachReady(const std::vector<int>& descriptors, Function&& function) {
+                for(auto& i : descriptors) {
+                    uint32_t events = 0;
+
+                    if((mInterest & SELECTOR_READABLE) && FD_ISSET(i, &mFdReadable)) {
+                        events |= SELECTOR_READABLE;
+                    }
+                    if((mInterest & SELECTOR_WRITABLE) && FD_ISSET(i, &mFdWritable)) {
+                        events |= SELECTOR_WRITABLE;
+                    }
+                    if((mInterest & SELECTOR_FAULTY) && FD_ISSET(i, &mFdFaulty)) {
+                        events |= SELECTOR_FAULTY;
+                    }
+                    if(events != 0) {
+                        function(i, events);
+                    }
+                }
+            }
+    };
+
+    /*! \class PollBackend
+        \brief The backend of BasicSelector with poll(). The pollfd array is kept between
+            the waits, so add() and remove() are constant time, and there is no FD_SETSIZE limit.*/
+    class PollBackend {
+        private:
+            // The poll() events of the interest.
+            short getEvents() const noexcept {
+                short events = 0;
+
+                if(mInterest & SELECTOR_READABLE) {
+                    events |= POLLIN;
+                }
+                if(mInterest & SELECTOR_WRITABLE) {
+                    events |= POLLOUT;
+                }
+                if(mInterest & SELECTOR_FAULTY) {
+                    events |= POLLPRI;
+                }
+                return events;
+            }
+
+            std::vector<pollfd> mPollFds; //the added sockets
+            std::vector<int> mPositions; //index in mPollFds by descriptor, -1 if it is not added
+            uint32_t mInterest; //SELECTOR_* flags
+
+        protected:
+
+        public:
+            PollBackend() noexcept :
+                mInterest(0)
+            {}
+
+            /*! \fn bool add(const int& fd)
+                \param fd
+                \return true*/
+            bool add(const int& fd) {
+                if((size_t) fd >= mPositions.size()) {
+                    mPositions.resize(fd + 1, -1);
+                }
+
+                pollfd entry;
+                entry.fd = fd;
+                entry.events = getEvents();
+                entry.revents = 0;
+
+                mPositions[fd] = mPollFds.size();
+                mPollFds.push_back(entry);
+                return true;
+            }
+
+            /*! \fn void remove(const int& fd)
+                \brief The last entry takes the place of the removed one.
+                \param fd*/
+            void remove(const int& fd) noexcept {
+                if((size_t) fd >= mPositions.size() || mPositions[fd] == -1) {
+                    return;
+                }
+
+                int position = mPositions[fd];
+                mPollFds[position] = mPollFds.back();
+                mPositions[mPollFds[position].fd] = position;
+                mPollFds.pop_back();
+                mPositions[fd] = -1;
+            }
+
+            /*! \fn void setInterest(const uint32_t& interest, const std::vector<int>& descriptors)
+                \param interest SELECTOR_* flags of every socket.
+                \param descriptors not used*/
+            void setInterest(const uint32_t& interest, const std::vector<int>& /*descriptors*/) noexcept {
+                mInterest = interest;
+
+                for(auto& i : mPollFds) {
+                    i.events = getEvents();
+                }
+            }
+
+            /*! \fn int wait(const timeval* timeout)
+                \param timeout Rounded up to milliseconds, nullptr waits until an event arrives.
+                \return the number of the ready sockets, 0 on timeout, -1 on error*/
+            int wait(const timeval* timeout) noexcept {
+                int milliseconds = timeout == nullptr ? -1 : timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+                return poll(mPollFds.data(), mPollFds.size(), milliseconds);
+            }
+
+            /*! \fn void forEachReady(const std::vector<int>& descriptors, Function&& function)
+                \brief Calls the function with the ready sockets of the last wait().
+                \param descriptors not used
+                \param function function(fd, events)
+                \tparam Function void(int, uint32_t)*/
+            template<typename Function>
+            void forEachReady(const std::vector<int>& /*descriptors*/, Function&& function) {
+                for(auto& i : mPollFds) {
+                    uint32_t events = 0;
+
+                    if((mInterest & SELECTOR_READABLE) && (i.revents & (POLLIN | POLLHUP | POLLERR))) {
+                        events |= SELECTOR_READABLE;
+                    }
+                    if((mInterest & SELECTOR_WRITABLE) && (i.revents & (POLLOUT | POLLERR))) {
+                        events |= SELECTOR_WRITABLE;
+                    }
+                    if((mInterest & SELECTOR_FAULTY) && (i.revents & (POLLPRI | POLLERR | POLLNVAL))) {
+                        events |= SELECTOR_FAULTY;
+                    }
+                    i.revents = 0;
+
+                    if(events != 0) {
+                        function(i.fd, events);
+                    }
+                }
+            }
+    };
+
+    /*! \class EpollBackend
+        \brief The backend of BasicSelector with epoll. The sockets are registered in the kernel
+            once, and a wait costs only as much as the number of the ready sockets.
+            It is the plain interface of Selector, EpollSelector has handlers, timers and more.*/
+    class EpollBackend {
+        private:
+            // The epoll events of the interest.
+            uint32_t getEvents() const noexcept {
+                uint32_t events = 0;
+
+                if(mInterest & SELECTOR_READABLE) {
+                    events |= EPOLLIN;
+                }
+                if(mInterest & SELECTOR_WRITABLE) {
+                    events |= EPOLLOUT;
+                }
+                if(mInterest & SELECTOR_FAULTY) {
+                    events |= EPOLLPRI;
+                }
+                return events;
+            }
+
+            int mEpoll; //epoll instance
+            std::vector<epoll_event> mEvents; //events returned by the kernel, grows if it was filled
+            int mReadyCount; //result of the last wait
+            uint32_t mInterest; //SELECTOR_* flags
+
+        protected:
+
+        public:
+            /*! \fn EpollBackend()
+                \brief Constructor. If the epoll instance could not be created,
+                    the common error callback is called with ERROR_SELECTOR_CREATE.*/
+            EpollBackend() noexcept :
+                mEpoll(-1),
+                mEvents(64),
+                mReadyCount(0),
+                mInterest(0)
+            {
+                if((mEpoll = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CREATE, "Selector could not be created.");
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy methods deleted. Moving methods are available.*/
+            EpollBackend(const EpollBackend& other) = delete;
+            EpollBackend& operator=(const EpollBackend& other) = delete;
+
+            EpollBackend(EpollBackend&& other) noexcept :
+                mEpoll(other.mEpoll),
+                mEvents(std::move(other.mEvents)),
+                mReadyCount(other.mReadyCount),
+                mInterest(other.mInterest)
+            {
+                other.mEpoll = -1;
+                other.mReadyCount = 0;
+            }
+
+            EpollBackend& operator=(EpollBackend&& other) noexcept {
+                std::swap(mEpoll, other.mEpoll);
+                std::swap(mEvents, other.mEvents);
+                std::swap(mReadyCount, other.mReadyCount);
+                std::swap(mInterest, other.mInterest);
+                return *this;
+            }
+
+            ~EpollBackend() {
+                if(mEpoll != -1) {
+                    close(mEpoll);
+                }
+            }
+
+            /*! \fn bool add(const int& fd)
+                \param fd
+                \return false if the kernel refused it*/
+            bool add(const int& fd) noexcept {
+                epoll_event event;
+                event.events = getEvents();
+                event.data.fd = fd;
+
+                return epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) == 0;
+            }
+
+            /*! \fn void remove(const int& fd)
+                \param fd*/
+            void remove(const int& fd) noexcept {
+                epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+
+                for(int i = 0; i < mReadyCount; i++) { //it is not reported from the last wait any more
+                    if(mEvents[i].data.fd == fd) {
+                        mEvents[i].events = 0;
+                    }
+                }
+            }
+
+            /*! \fn void setInterest(const uint32_t& interest, const std::vector<int>& descriptors)
+                \brief Every registered socket is modified in the kernel.
+                \param interest SELECTOR_* flags of every socket.
+                \param descriptors All added descriptors.*/
+            void setInterest(const uint32_t& interest, const std::vector<int>& descriptors) noexcept {
+                epoll_event event;
+                mInterest = interest;
+                event.events = getEvents();
+
+                for(auto& i : descriptors) {
+                    event.data.fd = i;
+
+                    if(epoll_ctl(mEpoll, EPOLL_CTL_MOD, i, &event) == -1) {
+                        gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not modify a socket.");
+                    }
+                }
+            }
+
+            /*! \fn int wait(const timeval* timeout)
+                \param timeout Rounded up to milliseconds, nullptr waits until an event arrives.
+                \return the number of the ready sockets, 0 on timeout, -1 on error*/
+            int wait(const timeval* timeout) {
+                if(mReadyCount == (int) mEvents.size()) { //there could be more ready sockets, make room for them
+                    mEvents.resize(mEvents.size() * 2);
+                }
+
+                int milliseconds = timeout == nullptr ? -1 : timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+                return mReadyCount = epoll_wait(mEpoll, mEvents.data(), mEvents.size(), milliseconds);
+            }
+
+            /*! \fn void forEachReady(const std::vector<int>& descriptors, Function&& function)
+                \brief Calls the function with the ready sockets of the last wait().
+                \param descriptors not used
+                \param function function(fd, events)
+                \tparam Function void(int, uint32_t)*/
+            template<typename Function>
+            void forEachReady(const std::vector<int>& /*descriptors*/, Function&& function) {
+                for(int i = 0; i < mReadyCount; i++) {
+                    uint32_t ready = mEvents[i].events;
+                    uint32_t events = 0;
+
+                    if((mInterest & SELECTOR_READABLE) && (ready & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                        events |= SELECTOR_READABLE;
+                    }
+                    if((mInterest & SELECTOR_WRITABLE) && (ready & (EPOLLOUT | EPOLLERR))) {
+                        events |= SELECTOR_WRITABLE;
+                    }
+                    if((mInterest & SELECTOR_FAULTY) && (ready & (EPOLLPRI | EPOLLERR))) {
+                        events |= SELECTOR_FAULTY;
+                    }
+                    if(events != 0) {
+                        function(mEvents[i].data.fd, events);
+                    }
+                }
+            }
+    };
+}//tnnf
+
+#endif
@@ -25,6 +25,7 @@ freely, subject to the following restrictions:
 #define TNNF_SOCKET_HPP
 
 #include <sys/socket.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <memory>
 
@@ -73,6 +74,14 @@ namespace tnnf {
         gSocketErrorFunction = function;
     }
 
+    /*! \struct ReadBudget
+        \brief Limits how much a drain() reads in one turn of the loop, so a busy peer can not keep
+            the others waiting. See EpollSelector::setReadBudget().*/
+    struct ReadBudget {
+        size_t bytes;   //!< received bytes, 0 means no limit
+        size_t packets; //!< built packets, 0 means no limit
+    };
+
     /*! \class Socket
         \brief This is an abstract class. All other type of sockets derive from this.
 
@@ -86,6 +95,8 @@ namespace tnnf {
             void receive(PacketBuffer& buffer, Address& address)
             void receive(PacketBuffer& buffer, const int& flags)
             void receive(PacketBuffer& buffer)
+            bool drain(PacketBuffer& buffer, const int& flags)
+            bool drain(PacketBuffer& buffer)
         \endcode */
     class Socket {
         private:
@@ -117,7 +128,9 @@ namespace tnnf {
                 mSendFlags(0),
                 mReceiveFlags(0)
             {
-                setSocketOption(SO_REUSEADDR, 1);
+                if(*mSocket != -1) { //a failed accept() is already reported
+                    setSocketOption(SO_REUSEADDR, 1);
+                }
             }
 
             /*! \fn Socket(const Address& address, const int& type, const int& protocol)
@@ -145,6 +158,54 @@ namespace tnnf {
 
             int mSendFlags, mReceiveFlags;
 
+            /* Read a stream socket until the read would block, it hung up, the budget is used up or the buffer
+               is full. build(received) builds the packets of the received bytes and returns their number.
+               It does not stop at a short read: the hang up can arrive with the data, and in edge-triggered
+               mode there is no other notification of it. more is set if it stopped before the read would block.*/
+            template<typename Build>
+            bool receiveStream(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags, Build&& build) {
+                ssize_t currentlyReceived = 0;
+                size_t freeSpace = 0;
+                size_t received = 0;
+                size_t packets = 0;
+
+                more = false;
+                while(true) {
+                    if((freeSpace = buffer.getWritableSize()) == 0) { //the stored packets have to be taken first
+                        more = true;
+                        return true;
+                    }
+                    if(budget.bytes > 0 && budget.bytes - received < freeSpace) {
+                        freeSpace = budget.bytes - received;
+                    }
+
+                    if((currentlyReceived = ::recv(getSocket(), buffer.getWritable(), freeSpace, flags | MSG_DONTWAIT)) <= 0) {
+                        if(currentlyReceived == 0) {
+                            gSocketErrorFunction(*this, ERROR_SOCKET_HANGUP, errno);
+                            return false;
+                        }
+                        else if(errno == EINTR) {
+                            continue;
+                        }
+                        else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                            return true;
+                        }
+                        else {
+                            gSocketErrorFunction(*this, ERROR_SOCKET_RECEIVE, errno);
+                            return false;
+                        }
+                    }
+
+                    packets += build(currentlyReceived);
+                    received += currentlyReceived;
+
+                    if((budget.bytes > 0 && received >= budget.bytes) || (budget.packets > 0 && packets >= budget.packets)) {
+                        more = true;
+                        return true;
+                    }
+                }
+            }
+
         public:
             /*! \fn Copy and Move constructors and assignments
                 \brief Copy and move are available.*/
@@ -193,6 +254,60 @@ namespace tnnf {
             virtual void receive(PacketBuffer& buffer, const int& flags) noexcept = 0;
             virtual void receive(PacketBuffer& buffer) noexcept = 0;
 
+            /*! \fn bool drain()
+                \brief On overridden drain() methods you have to read everything what is available
+                on the socket without blocking, write it into the specified PacketBuffer and let it
+                build the packets. It has to stop when the read would block.
+
+                It is made for the edge-triggered mode of the EpollSelector, where a readable
+                notification comes only once for the arrived data.
+                \param buffer The PacketBuffer which will be used.
+                \param flags The specified flags, which will be always used for once.
+                \return false if the connection hung up or failed, true otherwise*/
+            virtual bool drain(PacketBuffer& buffer, const int& flags) noexcept = 0;
+            virtual bool drain(PacketBuffer& buffer) noexcept = 0;
+
+            /*! \fn bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags)
+                \brief Like drain(), but it stops when the budget is used up, even if the read would not block.
+                    Then the rest has to be read later, for example after EpollSelector::requeue().
+                    The default implementation does not limit the reading, it calls drain().
+                \param buffer The PacketBuffer which will be used.
+                \param budget The limits of this call.
+                \param more Set to true if it stopped because of the budget, so there can be more to read.
+                \param flags The specified flags, which will be always used for once.
+                \return false if the connection hung up or failed, true otherwise*/
+            virtual bool drain(PacketBuffer& buffer, const ReadBudget&, bool& more, const int& flags) noexcept {
+                more = false;
+                return drain(buffer, flags);
+            }
+
+            virtual bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more) noexcept {
+                return drain(buffer, budget, more, mReceiveFlags);
+            }
+
+            /*! \fn bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags, Function&& onPacket)
+                \brief Reads a stream socket like the drain() of TcpSocket, but every packet is given to onPacket
+                    as soon as it is built, instead of storing it in the buffer.
+                \param buffer It keeps only the incomplete packet between the calls.
+                \param budget The limits of this call, the packets are counted too.
+                \param more Set to true if it stopped before the read would block.
+                \param flags Specify receiving flags for this receive. MSG_DONTWAIT is always added.
+                \param onPacket Called with every completed packet, see PacketBuffer::buildPackets().
+                \tparam Function void(Packet&)
+                \return false if the connection hung up or failed, true otherwise*/
+            template<typename Function>
+            bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags, Function&& onPacket) {
+                return receiveStream(buffer, budget, more, flags, [&buffer, &onPacket](const int& received) {
+                    size_t count = 0;
+
+                    buffer.buildPackets(received, [&count, &onPacket](Packet& packet) {
+                        count++;
+                        onPacket(packet);
+                    });
+                    return count;
+                });
+            }
+
             /*! \fn void setSendFlags(const int& flags)
                 \brief Set the flags, which will be used every time at sending on this socket except,
                 when the user specifies another one.
@@ -219,6 +334,18 @@ namespace tnnf {
                 }
             }
 
+            /*! \fn void setBlocking(const bool& blocking)
+                \brief Switches O_NONBLOCK of the descriptor. On error the socket error callback
+                    is called with ERROR_SOCKET_SETSOCKOPT.
+                \param blocking false to make the calls on the socket return EAGAIN instead of blocking*/
+            void setBlocking(const bool& blocking) noexcept {
+                int flags = ::fcntl(*mSocket, F_GETFL);
+
+                if(flags == -1 || ::fcntl(*mSocket, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK) == -1) {
+                    gSocketErrorFunction(*this, ERROR_SOCKET_SETSOCKOPT, errno);
+                }
+            }
+
             /*! \fn int getSocketOption(const int& optionName)
                 \brief Gets the value of a socket option at socket level (SOL_SOCKET)
                 \param optionName Specifies which socket option you want to request. (like SO_REUSEADDR)
@@ -0,0 +1,195 @@
+/*! \file SocketTable.hpp
+    \brief Table of the watched sockets, indexed by the file descriptor.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_SOCKETTABLE_HPP
+#define TNNF_SOCKETTABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tnnf {
+    typedef uint64_t SocketHandle; //the file descriptor and the generation of its slot, 0 is never used
+
+    /*! \class SocketTable
+        \brief Stores one value for every watched file descriptor.
+
+        The values are stored in a slot array indexed by the file descriptor, and
+        the used descriptors are listed in a dense array for iterating, so inserting,
+        erasing and finding is constant time. The arrays only grow when a larger
+        descriptor arrives, erasing never reallocates.
+
+        Every slot has a generation, which is increased when the slot is erased.
+        A SocketHandle contains it, so a handle of a closed socket does not find
+        a new socket with the same descriptor.
+        \tparam Value Copyable type, usually a pointer.*/
+    template<typename Value>
+    class SocketTable {
+        private:
+            // Value of one descriptor.
+            struct Slot {
+                Value value;
+                uint32_t generation; //increased on erase
+                uint32_t position; //index in mDescriptors
+                bool used;
+            };
+
+            std::vector<Slot> mSlots; //indexed by the file descriptor
+            std::vector<int> mDescriptors; //the used descriptors
+
+        protected:
+
+        public:
+            /*! \fn int GetDescriptor(const SocketHandle& handle)
+                \return the file descriptor of the handle*/
+            static int GetDescriptor(const SocketHandle& handle) noexcept {
+                return (int) (handle & 0xFFFFFFFF);
+            }
+
+            /*! \fn SocketTable()
+                \brief Constructor. The table is empty.*/
+            SocketTable() noexcept {}
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move are available.*/
+            SocketTable(const SocketTable& other) = default;
+            SocketTable& operator=(const SocketTable& other) = default;
+            SocketTable(SocketTable&& other) = default;
+            SocketTable& operator=(SocketTable&& other) = default;
+
+            //destructor
+            ~SocketTable() {}
+
+            /*! \fn SocketHandle insert(const int& fd, const Value& value)
+                \brief Stores a value for a descriptor.
+                \param fd
+                \param value
+                \return the handle of the slot, 0 if the descriptor is negative or already stored*/
+            SocketHandle insert(const int& fd, const Value& value) {
+                if(fd < 0) {
+                    return 0;
+                }
+
+                if((size_t) fd >= mSlots.size()) {
+                    size_t size = mSlots.empty() ? 64 : mSlots.size();
+                    while(size <= (size_t) fd) {
+                        size *= 2;
+                    }
+                    mSlots.resize(size, Slot{Value(), 1, 0, false});
+                }
+
+                Slot& slot = mSlots[fd];
+                if(slot.used) {
+                    return 0;
+                }
+
+                slot.value = value;
+                slot.position = mDescriptors.size();
+                slot.used = true;
+                mDescriptors.push_back(fd);
+
+                return ((SocketHandle) slot.generation << 32) | (uint32_t) fd;
+            }
+
+            /*! \fn bool erase(const int& fd)
+                \brief Removes the value of a descriptor. The handles of it become invalid.
+                \param fd
+                \return true if the descriptor was stored*/
+            bool erase(const int& fd) noexcept {
+                if(find(fd) == nullptr) {
+                    return false;
+                }
+
+                Slot& slot = mSlots[fd];
+                int last = mDescriptors.back();
+                mDescriptors[slot.position] = last;
+                mSlots[last].position = slot.position;
+                mDescriptors.pop_back();
+
+                slot.value = Value();
+                slot.used = false;
+                slot.generation++;
+                if(slot.generation == 0) {
+                    slot.generation = 1;
+                }
+                return true;
+            }
+
+            /*! \fn Value* find(const int& fd)
+                \return the value of the descriptor, nullptr if it is not stored*/
+            Value* find(const int& fd) noexcept {
+                if(fd < 0 || (size_t) fd >= mSlots.size() || !mSlots[fd].used) {
+                    return nullptr;
+                }
+                return &mSlots[fd].value;
+            }
+
+            /*! \fn Value* find(const SocketHandle& handle)
+                \return the value of the handle, nullptr if its descriptor was erased since the handle was made*/
+            Value* find(const SocketHandle& handle) noexcept {
+                Value* value = find(GetDescriptor(handle));
+
+                if(value == nullptr || mSlots[GetDescriptor(handle)].generation != (handle >> 32)) {
+                    return nullptr;
+                }
+                return value;
+            }
+
+            /*! \fn SocketHandle getHandle(const int& fd)
+                \return the handle of a stored descriptor, 0 if it is not stored*/
+            SocketHandle getHandle(const int& fd) const noexcept {
+                if(fd < 0 || (size_t) fd >= mSlots.size() || !mSlots[fd].used) {
+                    return 0;
+                }
+                return ((SocketHandle) mSlots[fd].generation << 32) | (uint32_t) fd;
+            }
+
+            /*! \fn const std::vector<int>& getDescriptors()
+                \return the stored descriptors, in no particular order. Inserting and erasing invalidates it.*/
+            const std::vector<int>& getDescriptors() const noexcept {
+                return mDescriptors;
+            }
+
+            /*! \fn size_t getSize()
+                \return the number of stored descriptors*/
+            size_t getSize() const noexcept {
+                return mDescriptors.size();
+            }
+
+            /*! \fn bool isEmpty()
+                \return true if nothing is stored*/
+            bool isEmpty() const noexcept {
+                return mDescriptors.empty();
+            }
+
+            /*! \fn void clear()
+                \brief Erases every descriptor. The memory is kept.*/
+            void clear() noexcept {
+                while(!mDescriptors.empty()) {
+                    erase(mDescriptors.back());
+                }
+            }
+    };
+}//tnnf
+
+#endif
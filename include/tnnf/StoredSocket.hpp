@@ -0,0 +1,141 @@
+/*! \file StoredSocket.hpp
+    \brief Place of a socket in a selector, without a heap allocation.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_STOREDSOCKET_HPP
+#define TNNF_STOREDSOCKET_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Socket.hpp"
+
+namespace tnnf {
+    /*! \class StoredSocket
+        \brief Holds a socket of a selector. The socket is copied or moved into an inline storage,
+            or only referenced if the user keeps it alive.
+
+        The storage is big enough for the sockets of the library, larger socket types
+        are allocated on the heap. Moving a socket in does not touch the reference counter
+        of the file descriptor.*/
+    class StoredSocket {
+        public:
+            static const size_t STORAGE_SIZE = 192; //bytes of the inline storage
+
+        private:
+            //! \enum Ownership How the socket is held.
+            enum Ownership {
+                EMPTY,      //!< no socket
+                INLINE,     //!< constructed in mStorage
+                HEAP,       //!< too large, allocated with new
+                WATCHED     //!< owned by the user
+            };
+
+            // Construct the socket in the storage.
+            template<typename SocketType, typename Argument>
+            void construct(Argument&& sock, std::true_type) {
+                mSocket = new(&mStorage) SocketType(std::forward<Argument>(sock));
+                mOwnership = INLINE;
+            }
+
+            // Allocate the socket.
+            template<typename SocketType, typename Argument>
+            void construct(Argument&& sock, std::false_type) {
+                mSocket = new SocketType(std::forward<Argument>(sock));
+                mOwnership = HEAP;
+            }
+
+            typename std::aligned_storage<STORAGE_SIZE, alignof(std::max_align_t)>::type mStorage;
+            Socket* mSocket; //the held socket
+            Ownership mOwnership;
+
+        protected:
+
+        public:
+            /*! \fn StoredSocket()
+                \brief Constructor. It is empty.*/
+            StoredSocket() noexcept :
+                mSocket(nullptr),
+                mOwnership(EMPTY)
+            {
+
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The selectors store the address of the socket.*/
+            StoredSocket(const StoredSocket& other) = delete;
+            StoredSocket& operator=(const StoredSocket& other) = delete;
+            StoredSocket(StoredSocket&& other) = delete;
+            StoredSocket& operator=(StoredSocket&& other) = delete;
+
+            /*! \fn ~StoredSocket()
+                \brief Destructor. Destroys the owned socket.*/
+            ~StoredSocket() {
+                reset();
+            }
+
+            /*! \fn void store(Argument&& sock)
+                \brief Copies or moves a socket in. The previous one is destroyed.
+                \param sock A SocketType, which is copied if it is an lvalue and moved if it is an rvalue.
+                \tparam SocketType The type of the stored socket.*/
+            template<typename SocketType, typename Argument>
+            void store(Argument&& sock) {
+                typedef std::integral_constant<bool, sizeof(SocketType) <= STORAGE_SIZE && alignof(SocketType) <= alignof(std::max_align_t)> Fits;
+
+                reset();
+                construct<SocketType>(std::forward<Argument>(sock), Fits());
+            }
+
+            /*! \fn void watch(Socket& sock)
+                \brief Refers to a socket without owning it. The previous one is destroyed.
+                \param sock It has to live until the StoredSocket is reset.*/
+            void watch(Socket& sock) noexcept {
+                reset();
+                mSocket = &sock;
+                mOwnership = WATCHED;
+            }
+
+            /*! \fn void reset()
+                \brief Destroys the owned socket, or forgets the watched one.*/
+            void reset() noexcept {
+                if(mOwnership == INLINE) {
+                    mSocket->~Socket();
+                }
+                else if(mOwnership == HEAP) {
+                    delete mSocket;
+                }
+
+                mSocket = nullptr;
+                mOwnership = EMPTY;
+            }
+
+            /*! \fn Socket* get()
+                \return the held socket, nullptr if it is empty*/
+            Socket* get() const noexcept {
+                return mSocket;
+            }
+    };
+}//tnnf
+
+#endif
@@ -31,9 +31,10 @@ namespace tnnf {
         \brief This class makes possible to build TCP connections, sending and receiving packets.*/
     class TcpSocket : public Socket {
         private:
-            TcpSocket(const std::shared_ptr<int>& sock, const Address& address) noexcept : Socket(sock, address) {} //constructor for GetInstace method.
 
         protected:
+            TcpSocket(const std::shared_ptr<int>& sock, const Address& address) noexcept : Socket(sock, address) {} //constructor for GetInstace method.
+
             /*! \fn TcpSocket(const Address& address)
                 \brief Constructor for initializing a new TCP socket.
                 \param address Ip address, which will be stored with the socket.*/
@@ -49,6 +50,21 @@ namespace tnnf {
             }
 
         public:
+            /*! \fn static TcpSocket FromDescriptor(const int& descriptor)
+                \brief Takes over a connected descriptor, for example one received from another
+                    process (see Handover.hpp). The address is read with getpeername().
+                \param descriptor It is closed by the last copy of the socket.
+                \return with the socket*/
+            static TcpSocket FromDescriptor(const int& descriptor) {
+                sockaddr_storage address;
+                socklen_t addressLength = sizeof(address);
+
+                memset(&address, 0, sizeof(address));
+                ::getpeername(descriptor, (sockaddr*)&address, &addressLength);
+
+                return TcpSocket(std::make_shared<int>(descriptor), Address(address));
+            }
+
             /*! \fn Copy and Move constructors and assignments
                 \brief Copy and move are available.*/
             TcpSocket(const TcpSocket& other) = default;
@@ -165,7 +181,7 @@ namespace tnnf {
                 ssize_t currentlyReceived = 0;
 
                 do {
-                    if((currentlyReceived = ::recv(getSocket(), buffer.getBuffer() + buffer.getCurrentSize(), buffer.getSize(), flags)) <= 0) {
+                    if((currentlyReceived = ::recv(getSocket(), buffer.getWritable(), buffer.getWritableSize(), flags)) <= 0) {
                         if(currentlyReceived == 0) {
                             gSocketErrorFunction(*this, ERROR_SOCKET_HANGUP, errno);
                             return;
@@ -186,6 +202,62 @@ namespace tnnf {
             void receive(PacketBuffer& buffer) noexcept final {
                 receive(buffer, mReceiveFlags);
             }
+
+            using Socket::drain;
+
+            /*! \fn bool drain(PacketBuffer& buffer, const int& flags)
+                \brief Reads until the read would block or the connection hung up, without blocking.
+                    If the buffer becomes full before, the rest stays in the kernel, and the common error
+                    callback is called with ERROR_PACKETBUFFER_TOO_SMALL.
+                \param buffer Where the packets will be stored.
+                \param flags Specify receiving flags for this receive. MSG_DONTWAIT is always added.
+                \return false if the connection hung up or failed, true otherwise*/
+            bool drain(PacketBuffer& buffer, const int& flags) noexcept final {
+                bool full = false;
+
+                if(!drain(buffer, ReadBudget{0, 0}, full, flags)) {
+                    return false;
+                }
+                if(full) { //in edge-triggered mode it would not be reported again
+                    gCommonErrorFunction(ERROR_PACKETBUFFER_TOO_SMALL, "PacketBuffer is full, the rest of the received bytes stays in the kernel.");
+                }
+                return true;
+            }
+
+            /*! \fn bool drain(PacketBuffer& buffer)
+                \brief Reads until the read would block, with the stored flags.
+                \param buffer Where the packets will be stored.
+                \return false if the connection hung up or failed, true otherwise*/
+            bool drain(PacketBuffer& buffer) noexcept final {
+                return drain(buffer, mReceiveFlags);
+            }
+
+            /*! \fn bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags)
+                \brief Reads until the read would block or the budget is used up, without blocking.
+                    A full buffer stops it too, then the stored packets have to be taken first.
+                \param buffer Where the packets will be stored.
+                \param budget The limits of this call, a receive is never longer than the rest of budget.bytes.
+                \param more Set to true if it stopped before the read would block.
+                \param flags Specify receiving flags for this receive. MSG_DONTWAIT is always added.
+                \return false if the connection hung up or failed, true otherwise*/
+            bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more, const int& flags) noexcept final {
+                return receiveStream(buffer, budget, more, flags, [&buffer](const int& received) {
+                    size_t stored = buffer.getNumOfStoredPackets();
+
+                    buffer.buildPackets(received);
+                    return buffer.getNumOfStoredPackets() - stored;
+                });
+            }
+
+            /*! \fn bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more)
+                \brief Reads until the read would block or the budget is used up, with the stored flags.
+                \param buffer Where the packets will be stored.
+                \param budget The limits of this call.
+                \param more Set to true if it stopped before the read would block.
+                \return false if the connection hung up or failed, true otherwise*/
+            bool drain(PacketBuffer& buffer, const ReadBudget& budget, bool& more) noexcept final {
+                return drain(buffer, budget, more, mReceiveFlags);
+            }
     };
 }//tnnf
 #endif
@@ -0,0 +1,354 @@
+/*! \file TimerWheel.hpp
+    \brief Hierarchical timer wheel for many timers with constant time insert and cancel.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_TIMERWHEEL_HPP
+#define TNNF_TIMERWHEEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace tnnf {
+    typedef std::function<void()> TimerCallback; //called when the timer expires
+    typedef uint64_t TimerId; //identifies a timer, 0 is never used
+
+    /*! \class TimerWheel
+        \brief Stores timers in a hierarchy of wheels.
+
+        The time is measured in ticks (the Selectors use milliseconds). There are 5 levels
+        with 64 slots each: the first level has one slot for every tick of the current 64 ticks,
+        the next level has one slot for every 64 ticks of the current 4096 ticks, and so on.
+        When the time reaches a slot of a higher level, its timers are moved down.
+        Timers further than 2^30 ticks wait in an overflow list.
+
+        Inserting and cancelling is constant time, the timers are stored in one array
+        and linked by indexes, so it does not allocate memory after the array is grown.
+        A TimerId contains a generation, so cancelling an expired timer is harmless.*/
+    class TimerWheel {
+        private:
+            static const unsigned int LEVELS = 5;
+            static const unsigned int SLOT_BITS = 6;
+            static const unsigned int SLOTS = 1 << SLOT_BITS;
+            static const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+            static const uint8_t OVERFLOW_LEVEL = LEVELS;
+
+            // One timer.
+            struct Node {
+                uint64_t expiry; //absolute tick
+                uint64_t interval; //0 if it is not periodic
+                TimerCallback callback;
+                uint32_t previous, next; //links in the slot, next links the free list too
+                uint32_t generation; //increased when the timer is freed
+                uint8_t level, slot;
+                bool linked; //stored in a slot
+                bool firing; //its callback runs
+            };
+
+            // Bits above the given slot index.
+            static uint64_t MaskAbove(const uint64_t& index) noexcept {
+                return index >= SLOTS - 1 ? 0 : (~0ULL << (index + 1));
+            }
+
+            // Head of the list of a slot.
+            uint32_t& head(uint8_t level, uint8_t slot) noexcept {
+                return level == OVERFLOW_LEVEL ? mOverflow : mSlots[level][slot];
+            }
+
+            // Put a timer into the slot of its expiry.
+            void link(const uint32_t& index) noexcept {
+                Node& node = mNodes[index];
+                node.level = OVERFLOW_LEVEL;
+                node.slot = 0;
+
+                for(unsigned int level = 0; level < LEVELS; level++) {
+                    unsigned int shift = SLOT_BITS * (level + 1);
+
+                    if((node.expiry >> shift) == (mNow >> shift)) { //in the same block of the next level
+                        node.level = level;
+                        node.slot = (node.expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+                        mBitmaps[level] |= 1ULL << node.slot;
+                        break;
+                    }
+                }
+
+                uint32_t& first = head(node.level, node.slot);
+                node.previous = NONE;
+                node.next = first;
+                if(first != NONE) {
+                    mNodes[first].previous = index;
+                }
+                first = index;
+                node.linked = true;
+            }
+
+            // Take a timer out of its slot.
+            void unlink(const uint32_t& index) noexcept {
+                Node& node = mNodes[index];
+
+                if(node.previous != NONE) {
+                    mNodes[node.previous].next = node.next;
+                }
+                else {
+                    head(node.level, node.slot) = node.next;
+                }
+                if(node.next != NONE) {
+                    mNodes[node.next].previous = node.previous;
+                }
+
+                if(node.level != OVERFLOW_LEVEL && mSlots[node.level][node.slot] == NONE) {
+                    mBitmaps[node.level] &= ~(1ULL << node.slot);
+                }
+                node.linked = false;
+            }
+
+            // Give back a timer to the free list.
+            void release(const uint32_t& index) noexcept {
+                Node& node = mNodes[index];
+                node.generation++;
+                node.callback = nullptr;
+                node.firing = false;
+                node.next = mFree;
+                mFree = index;
+                mSize--;
+            }
+
+            // Move every timer of a slot to the lower levels.
+            void cascade(uint8_t level, uint8_t slot) noexcept {
+                uint32_t index = head(level, slot);
+                head(level, slot) = NONE;
+                if(level != OVERFLOW_LEVEL) {
+                    mBitmaps[level] &= ~(1ULL << slot);
+                }
+
+                while(index != NONE) {
+                    uint32_t next = mNodes[index].next;
+                    link(index);
+                    index = next;
+                }
+            }
+
+            // Fire every timer of the current tick.
+            void fire() {
+                uint8_t slot = mNow & (SLOTS - 1);
+
+                while(mSlots[0][slot] != NONE) {
+                    uint32_t index = mSlots[0][slot];
+                    unlink(index);
+                    mNodes[index].firing = true;
+
+                    uint32_t generation = mNodes[index].generation;
+                    TimerCallback callback = std::move(mNodes[index].callback); //the callback can add timers and grow the array
+                    callback();
+
+                    Node& node = mNodes[index];
+                    if(node.generation != generation) { //cancelled by its callback
+                        node.generation--;
+                        release(index);
+                    }
+                    else if(node.interval > 0) {
+                        node.firing = false;
+                        node.callback = std::move(callback);
+                        node.expiry = std::max(node.expiry + node.interval, mNow + 1);
+                        link(index);
+                    }
+                    else {
+                        release(index);
+                    }
+                }
+            }
+
+            std::vector<Node> mNodes; //all timers, free or not
+            uint32_t mSlots[LEVELS][SLOTS]; //heads of the lists
+            uint64_t mBitmaps[LEVELS]; //non-empty slots
+            uint32_t mOverflow; //head of the timers beyond the last level
+            uint32_t mFree; //head of the free list
+            uint64_t mNow; //current tick
+            size_t mSize; //number of timers
+
+        protected:
+
+        public:
+            /*! \fn TimerWheel()
+                \brief Constructor. The time starts at tick 0.*/
+            TimerWheel() noexcept :
+                mOverflow(NONE),
+                mFree(NONE),
+                mNow(0),
+                mSize(0)
+            {
+                for(unsigned int level = 0; level < LEVELS; level++) {
+                    mBitmaps[level] = 0;
+
+                    for(unsigned int slot = 0; slot < SLOTS; slot++) {
+                        mSlots[level][slot] = NONE;
+                    }
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move are available.*/
+            TimerWheel(const TimerWheel& other) = default;
+            TimerWheel& operator=(const TimerWheel& other) = default;
+            TimerWheel(TimerWheel&& other) = default;
+            TimerWheel& operator=(TimerWheel&& other) = default;
+
+            //destructor
+            ~TimerWheel() {}
+
+            /*! \fn TimerId add(const uint64_t& expiry, const TimerCallback& callback, const uint64_t& interval = 0)
+                \brief Adds a timer.
+                \param expiry The absolute tick, when the callback has to be called.
+                    If it is not in the future, it will be called at the next tick.
+                \param callback
+                \param interval If it is not 0, the timer will be called again in every interval ticks,
+                    until it is cancelled.
+                \return the id of the timer*/
+            TimerId add(const uint64_t& expiry, const TimerCallback& callback, const uint64_t& interval = 0) {
+                uint32_t index;
+
+                if(mFree != NONE) {
+                    index = mFree;
+                    mFree = mNodes[index].next;
+                }
+                else {
+                    index = mNodes.size();
+                    mNodes.emplace_back();
+                    mNodes[index].generation = 1;
+                }
+
+                Node& node = mNodes[index];
+                node.expiry = std::max(expiry, mNow + 1);
+                node.interval = interval;
+                node.callback = callback;
+                node.firing = false;
+                mSize++;
+
+                link(index);
+
+                return ((TimerId) node.generation << 32) | index;
+            }
+
+            /*! \fn bool cancel(const TimerId& id)
+                \brief Cancels a timer. It can be called from the callback of a timer too.
+                \param id
+                \return true if the timer was waiting or firing, false if it was unknown*/
+            bool cancel(const TimerId& id) noexcept {
+                uint32_t index = id & NONE;
+
+                if(index >= mNodes.size() || mNodes[index].generation != (id >> 32)) {
+                    return false;
+                }
+
+                Node& node = mNodes[index];
+                if(node.firing) {
+                    node.generation++; //fire() releases it after the callback
+                    node.interval = 0;
+                    return true;
+                }
+                if(!node.linked) {
+                    return false;
+                }
+
+                unlink(index);
+                release(index);
+                return true;
+            }
+
+            /*! \fn void advance(const uint64_t& now)
+                \brief Moves the time forward, and calls the callbacks of the expired timers.
+                    Empty ranges of ticks are skipped.
+                \param now The current tick.*/
+            void advance(const uint64_t& now) {
+                uint64_t next;
+
+                while((next = getNextTick()) <= now) {
+                    mNow = next;
+
+                    if((mNow & ((1ULL << (SLOT_BITS * LEVELS)) - 1)) == 0) {
+                        cascade(OVERFLOW_LEVEL, 0);
+                    }
+                    for(unsigned int level = LEVELS - 1; level > 0; level--) {
+                        if((mNow & ((1ULL << (SLOT_BITS * level)) - 1)) == 0) {
+                            cascade(level, (mNow >> (SLOT_BITS * level)) & (SLOTS - 1));
+                        }
+                    }
+
+                    fire();
+                }
+
+                if(now > mNow) {
+                    mNow = now;
+                }
+            }
+
+            /*! \fn uint64_t getNextTick()
+                \return The next tick when advance() has something to do. It is not later than
+                    the earliest expiry. std::numeric_limits<uint64_t>::max() if there are no timers.*/
+            uint64_t getNextTick() const noexcept {
+                uint64_t bits = mBitmaps[0] & MaskAbove(mNow & (SLOTS - 1));
+
+                if(bits != 0) {
+                    return (mNow & ~((uint64_t) SLOTS - 1)) | __builtin_ctzll(bits);
+                }
+
+                for(unsigned int level = 1; level < LEVELS; level++) {
+                    bits = mBitmaps[level] & MaskAbove((mNow >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+                    if(bits != 0) {
+                        unsigned int shift = SLOT_BITS * (level + 1);
+                        return ((mNow >> shift) << shift) | ((uint64_t) __builtin_ctzll(bits) << (SLOT_BITS * level));
+                    }
+                }
+
+                if(mOverflow != NONE) {
+                    unsigned int shift = SLOT_BITS * LEVELS;
+                    return ((mNow >> shift) + 1) << shift;
+                }
+
+                return std::numeric_limits<uint64_t>::max();
+            }
+
+            /*! \fn const uint64_t& getNow()
+                \return the current tick*/
+            const uint64_t& getNow() const noexcept {
+                return mNow;
+            }
+
+            /*! \fn size_t getSize()
+                \return the number of active timers*/
+            size_t getSize() const noexcept {
+                return mSize;
+            }
+
+            /*! \fn bool isEmpty()
+                \return true if there are no timers*/
+            bool isEmpty() const noexcept {
+                return mSize == 0;
+            }
+    };
+}//tnnf
+
+#endif
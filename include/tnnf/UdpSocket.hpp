@@ -154,7 +154,7 @@ namespace tnnf {
                 ssize_t currentlyReceived = 0;
 
                 do {
-                    if((currentlyReceived = ::recvfrom(getSocket(), buffer.getBuffer() + buffer.getCurrentSize(), buffer.getSize(), flags, address.toSockaddr(), &msAddressLength)) <= 0) {
+                    if((currentlyReceived = ::recvfrom(getSocket(), buffer.getWritable(), buffer.getWritableSize(), flags, address.toSockaddr(), &msAddressLength)) <= 0) {
                         if(currentlyReceived == 0) {
                             gSocketErrorFunction(*this, ERROR_SOCKET_HANGUP, errno);
                             return;
@@ -185,7 +185,7 @@ namespace tnnf {
                 ssize_t currentlyReceived = 0;
 
                 do {
-                    if((currentlyReceived = ::recvfrom(getSocket(), buffer.getBuffer() + buffer.getCurrentSize(), buffer.getSize(), flags, 0, 0)) <= 0) {
+                    if((currentlyReceived = ::recvfrom(getSocket(), buffer.getWritable(), buffer.getWritableSize(), flags, 0, 0)) <= 0) {
                         if(currentlyReceived == 0) {
                             gSocketErrorFunction(*this, ERROR_SOCKET_HANGUP, errno);
                         }
@@ -205,6 +205,43 @@ namespace tnnf {
                 receive(buffer, mReceiveFlags);
             }
 
+            /*! \fn bool drain(PacketBuffer& buffer, const int& flags)
+                \brief Receives datagrams until the read would block, without blocking.
+                \param buffer Where the packets will be stored.
+                \param flags Specify receiving flags for this receive. MSG_DONTWAIT is always added.
+                \return false if the receiving failed, true otherwise*/
+            bool drain(PacketBuffer& buffer, const int& flags) noexcept final {
+                ssize_t currentlyReceived = 0;
+                size_t freeSpace = 0;
+
+                while((freeSpace = buffer.getWritableSize()) > 0) {
+                    if((currentlyReceived = ::recvfrom(getSocket(), buffer.getWritable(), freeSpace, flags | MSG_DONTWAIT, 0, 0)) == -1) {
+                        if(errno == EINTR) {
+                            continue;
+                        }
+                        else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                            return true;
+                        }
+                        else {
+                            gSocketErrorFunction(*this, ERROR_SOCKET_RECEIVE, errno);
+                            return false;
+                        }
+                    }
+
+                    buffer.buildPackets(currentlyReceived);
+                }
+
+                return true;
+            }
+
+            /*! \fn bool drain(PacketBuffer& buffer)
+                \brief Receives datagrams until the read would block, with the stored flags.
+                \param buffer Where the packets will be stored.
+                \return false if the receiving failed, true otherwise*/
+            bool drain(PacketBuffer& buffer) noexcept final {
+                return drain(buffer, mReceiveFlags);
+            }
+
     };
 
     socklen_t UdpSocket::msAddressLength = sizeof(sockaddr);
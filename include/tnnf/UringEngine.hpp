@@ -0,0 +1,819 @@
+/*! \file UringEngine.hpp
+    \brief Completion based receiving and sending with io_uring.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_URINGENGINE_HPP
+#define TNNF_URINGENGINE_HPP
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EpollSelector.hpp"
+#include "Socket.hpp"
+#include "tnnf.hpp"
+
+namespace tnnf {
+    /*! \class UringEngine
+        \brief Receives and sends packets with io_uring.
+
+        Every added socket has a multishot receive in the kernel, which picks its memory
+        from a ring of provided buffers, so the sockets do not need readiness checks and
+        one io_uring_enter() call can serve hundreds of connections. The received bytes are
+        copied into the PacketBuffer which was given with the socket, and the socket is
+        reported as readable. Sending is submitted in the same batch.
+
+        If the kernel does not support io_uring (or multishot receive with provided buffers),
+        the engine falls back to an EpollSelector and drain(), with the same interface:
+        \code
+        std::vector<tnnf::Socket*> readableSockets;
+        tnnf::UringEngine engine(&readableSockets);
+
+        engine.add(client, clientBuffer);
+
+        while(!exit) {
+            engine.update();
+
+            for(auto& sock : readableSockets) {
+                tnnf::PacketBuffer& buffer = engine.getBuffer(*sock);
+
+                while(buffer.isPacketStored()) {
+                    engine.send(*sock, buffer.getPacket());
+                }
+            }
+        }
+        \endcode
+        Hang ups and receiving errors are reported through the socket error callback.*/
+    class UringEngine {
+        private:
+            // One added socket.
+            struct SendOperation;
+
+            struct Registration {
+                Socket* socket; //copy of the added socket
+                PacketBuffer* buffer; //user provided buffer
+                unsigned int inFlight; //submitted operations without final completion
+                uint64_t reported; //the last update when the socket was reported as readable
+                bool datagram; //UDP socket, packets are sent to its address
+                bool armed; //the multishot receive is active
+                bool closed; //hung up or failed
+                bool removed; //removed by the user, it is freed when inFlight reaches 0
+                std::deque<SendOperation*> outbound; //only the first is submitted, so a short send can not be overtaken
+            };
+
+            // One submitted send.
+            struct SendOperation {
+                Registration* owner;
+                std::string bytes;
+                size_t offset;
+                msghdr message;
+                iovec vector;
+            };
+
+            static const uint64_t TAG_RECEIVE = 0;
+            static const uint64_t TAG_SEND = 1;
+            static const uint64_t TAG_CANCEL = 2;
+            static const uint64_t TAG_MASK = 3;
+            static const uint16_t BUFFER_GROUP = 0;
+
+            static int Setup(unsigned int entries, io_uring_params* params) {
+                return (int) syscall(__NR_io_uring_setup, entries, params);
+            }
+
+            static int Enter(int ring, unsigned int toSubmit, unsigned int minComplete, unsigned int flags, void* argument, size_t argumentSize) {
+                return (int) syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, argument, argumentSize);
+            }
+
+            static int Register(int ring, unsigned int opcode, void* argument, unsigned int count) {
+                return (int) syscall(__NR_io_uring_register, ring, opcode, argument, count);
+            }
+
+            // Map the rings and the provided buffers. Returns false if anything is not supported.
+            bool initialize(const unsigned int& entries) noexcept {
+                io_uring_params params;
+                memset(&params, 0, sizeof(params));
+                params.flags = IORING_SETUP_CQSIZE;
+                params.cq_entries = entries * 8; //multishot receives produce many completions
+
+                if((mRing = Setup(entries, &params)) == -1) {
+                    return false;
+                }
+
+                if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+                    return false;
+                }
+
+                //multishot receive came with IORING_OP_SEND_ZC (Linux 6.0)
+                size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+                std::unique_ptr<char[]> probeMemory(new char[probeSize]);
+                memset(probeMemory.get(), 0, probeSize);
+                io_uring_probe* probe = (io_uring_probe*) probeMemory.get();
+
+                if(Register(mRing, IORING_REGISTER_PROBE, probe, 256) == -1 || probe->last_op < IORING_OP_SEND_ZC ||
+                   !(probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED)) {
+                    return false;
+                }
+
+                mRingSize = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+                if((mRingMemory = (char*) mmap(nullptr, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQ_RING)) == MAP_FAILED) {
+                    mRingMemory = nullptr;
+                    return false;
+                }
+
+                mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                if((mSqes = (io_uring_sqe*) mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQES)) == MAP_FAILED) {
+                    mSqes = nullptr;
+                    return false;
+                }
+
+                mSqHead = (unsigned int*) (mRingMemory + params.sq_off.head);
+                mSqTail = (unsigned int*) (mRingMemory + params.sq_off.tail);
+                mSqMask = *(unsigned int*) (mRingMemory + params.sq_off.ring_mask);
+                mSqEntries = params.sq_entries;
+                mSqArray = (unsigned int*) (mRingMemory + params.sq_off.array);
+                mCqHead = (unsigned int*) (mRingMemory + params.cq_off.head);
+                mCqTail = (unsigned int*) (mRingMemory + params.cq_off.tail);
+                mCqMask = *(unsigned int*) (mRingMemory + params.cq_off.ring_mask);
+                mCqes = (io_uring_cqe*) (mRingMemory + params.cq_off.cqes);
+                mSqLocalTail = *mSqTail;
+
+                mBufferRingSize = mBufferCount * sizeof(io_uring_buf);
+                if((mBufferRing = (io_uring_buf*) mmap(nullptr, mBufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+                    mBufferRing = nullptr;
+                    return false;
+                }
+
+                io_uring_buf_reg registration;
+                memset(&registration, 0, sizeof(registration));
+                registration.ring_addr = (uint64_t) mBufferRing;
+                registration.ring_entries = mBufferCount;
+                registration.bgid = BUFFER_GROUP;
+
+                if(Register(mRing, IORING_REGISTER_PBUF_RING, &registration, 1) == -1) {
+                    return false;
+                }
+
+                //the ring tail is overlaid with the reserved field of the first entry
+                mBufferTail = (uint16_t*) ((char*) mBufferRing + offsetof(io_uring_buf, resv));
+                mBufferMemory.reset(new char[(size_t) mBufferCount * mBufferSize]);
+
+                for(unsigned int i = 0; i < mBufferCount; i++) {
+                    provideBuffer(i, i);
+                }
+                __atomic_store_n(mBufferTail, (uint16_t) mBufferCount, __ATOMIC_RELEASE);
+
+                return true;
+            }
+
+            // Unmap everything which was mapped by initialize().
+            void release() noexcept {
+                if(mBufferRing != nullptr) {
+                    munmap(mBufferRing, mBufferRingSize);
+                    mBufferRing = nullptr;
+                }
+                if(mSqes != nullptr) {
+                    munmap(mSqes, mSqesSize);
+                    mSqes = nullptr;
+                }
+                if(mRingMemory != nullptr) {
+                    munmap(mRingMemory, mRingSize);
+                    mRingMemory = nullptr;
+                }
+                if(mRing != -1) {
+                    close(mRing);
+                    mRing = -1;
+                }
+            }
+
+            // Put a buffer to the given position of the provided buffer ring, without publishing it.
+            void provideBuffer(const uint16_t& bufferId, const unsigned int& position) noexcept {
+                io_uring_buf* entry = &mBufferRing[position & (mBufferCount - 1)];
+                entry->addr = (uint64_t) (mBufferMemory.get() + (size_t) bufferId * mBufferSize);
+                entry->len = mBufferSize;
+                entry->bid = bufferId;
+            }
+
+            // Give back a buffer to the kernel.
+            void recycleBuffer(const uint16_t& bufferId) noexcept {
+                uint16_t tail = *mBufferTail;
+                provideBuffer(bufferId, tail);
+                __atomic_store_n(mBufferTail, (uint16_t) (tail + 1), __ATOMIC_RELEASE);
+            }
+
+            // Get a free submission queue entry, submits the queue if it is full.
+            io_uring_sqe* getSqe() noexcept {
+                if(mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) >= mSqEntries) {
+                    submit();
+                }
+
+                unsigned int index = mSqLocalTail & mSqMask;
+                io_uring_sqe* sqe = &mSqes[index];
+                memset(sqe, 0, sizeof(io_uring_sqe));
+                mSqArray[index] = index;
+                mSqLocalTail++;
+                mToSubmit++;
+
+                return sqe;
+            }
+
+            // Publish the queued entries, and submit them without waiting.
+            void submit() noexcept {
+                __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+
+                if(mToSubmit > 0) {
+                    int submitted;
+                    if((submitted = Enter(mRing, mToSubmit, 0, 0, nullptr, 0)) > 0) {
+                        mToSubmit -= submitted;
+                    }
+                }
+            }
+
+            // Start the multishot receive of a socket.
+            void armReceive(Registration* registration) noexcept {
+                io_uring_sqe* sqe = getSqe();
+                sqe->opcode = IORING_OP_RECV;
+                sqe->fd = registration->socket->getSocket();
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = BUFFER_GROUP;
+                sqe->user_data = (uint64_t) registration | TAG_RECEIVE;
+
+                registration->armed = true;
+                registration->inFlight++;
+            }
+
+            // Submit the rest of a send.
+            void submitSend(SendOperation* operation) noexcept {
+                operation->vector.iov_base = &operation->bytes[operation->offset];
+                operation->vector.iov_len = operation->bytes.size() - operation->offset;
+
+                io_uring_sqe* sqe = getSqe();
+                sqe->opcode = IORING_OP_SENDMSG;
+                sqe->fd = operation->owner->socket->getSocket();
+                sqe->addr = (uint64_t) &operation->message;
+                sqe->len = 1;
+                sqe->msg_flags = MSG_NOSIGNAL;
+                sqe->user_data = (uint64_t) operation | TAG_SEND;
+
+                operation->owner->inFlight++;
+            }
+
+            // Copy the received bytes into the buffer of the socket, and build the packets.
+            // If the buffer is full, the rest is dropped, the kernel does not keep it.
+            void feed(Registration* registration, const char* data, size_t size) noexcept {
+                PacketBuffer& buffer = *registration->buffer;
+
+                while(size > 0) {
+                    size_t length = std::min(size, buffer.getWritableSize());
+                    if(length == 0) {
+                        gCommonErrorFunction(ERROR_PACKETBUFFER_TOO_SMALL, "PacketBuffer is full, the rest of the received bytes is dropped.");
+                        return;
+                    }
+
+                    memcpy(buffer.getWritable(), data, length);
+                    buffer.buildPackets(length);
+
+                    data += length;
+                    size -= length;
+                }
+            }
+
+            // Report the socket as readable once per update.
+            void report(Registration* registration) noexcept {
+                if(mReadable != nullptr && registration->reported != mIteration) {
+                    registration->reported = mIteration;
+                    mReadable->push_back(registration->socket);
+                }
+            }
+
+            // Handle a completion of a multishot receive.
+            void completeReceive(Registration* registration, const io_uring_cqe& cqe) noexcept {
+                if(cqe.flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bufferId = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+                    if(cqe.res > 0 && !registration->removed) {
+                        feed(registration, mBufferMemory.get() + (size_t) bufferId * mBufferSize, cqe.res);
+                        report(registration);
+                    }
+
+                    recycleBuffer(bufferId);
+                }
+
+                if(!(cqe.flags & IORING_CQE_F_MORE)) {
+                    registration->armed = false;
+                    registration->inFlight--;
+                }
+
+                if(registration->removed || registration->closed) {
+                    return;
+                }
+
+                if(cqe.res == 0) {
+                    int cErrno = 0;
+                    registration->closed = true;
+                    gSocketErrorFunction(*registration->socket, ERROR_SOCKET_HANGUP, cErrno);
+                }
+                else if(cqe.res < 0 && cqe.res != -ENOBUFS) {
+                    int cErrno = -cqe.res;
+                    registration->closed = true;
+                    gSocketErrorFunction(*registration->socket, ERROR_SOCKET_RECEIVE, cErrno);
+                }
+                else if(!registration->armed) { //ran out of buffers, or the kernel stopped it
+                    armReceive(registration);
+                }
+            }
+
+            // Give back the queued sends of a socket, which will not be submitted.
+            void dropSends(Registration* registration) noexcept {
+                for(auto& i : registration->outbound) {
+                    mFreeSends.push_back(i);
+                }
+                registration->outbound.clear();
+            }
+
+            // Handle a completion of a send, and submit the next one of the socket.
+            void completeSend(SendOperation* operation, const io_uring_cqe& cqe) noexcept {
+                Registration* owner = operation->owner;
+                owner->inFlight--;
+
+                if(owner->removed || owner->closed) {
+                    dropSends(owner);
+                    return;
+                }
+
+                if(cqe.res > 0 && operation->offset + cqe.res < operation->bytes.size()) {
+                    operation->offset += cqe.res;
+                    submitSend(operation);
+                    return;
+                }
+
+                if(cqe.res < 0) {
+                    int cErrno = -cqe.res;
+                    gSocketErrorFunction(*owner->socket, ERROR_SOCKET_SEND, cErrno);
+
+                    if(!owner->datagram) { //the rest of the stream can not be sent
+                        owner->closed = true;
+                        dropSends(owner);
+                        return;
+                    }
+                }
+
+                owner->outbound.pop_front();
+                mFreeSends.push_back(operation);
+
+                if(!owner->outbound.empty()) {
+                    submitSend(owner->outbound.front());
+                }
+            }
+
+            // Process all completions.
+            void reap() noexcept {
+                unsigned int head = *mCqHead;
+                unsigned int tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+
+                while(head != tail) {
+                    io_uring_cqe cqe = mCqes[head & mCqMask];
+                    head++;
+
+                    switch(cqe.user_data & TAG_MASK) {
+                        case TAG_RECEIVE:
+                            completeReceive((Registration*) (cqe.user_data & ~TAG_MASK), cqe);
+                            break;
+                        case TAG_SEND:
+                            completeSend((SendOperation*) (cqe.user_data & ~TAG_MASK), cqe);
+                            break;
+                        default:
+                            break;
+                    }
+
+                    if(head == tail) { //handlers can produce new completions
+                        __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+                        tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+                    }
+                }
+
+                __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+            }
+
+            // Free the removed registrations without pending operations.
+            void collect() noexcept {
+                for(size_t i = 0; i < mRemoved.size();) {
+                    if(mRemoved[i]->inFlight == 0) {
+                        delete mRemoved[i]->socket;
+                        delete mRemoved[i];
+                        mRemoved[i] = mRemoved.back();
+                        mRemoved.pop_back();
+                    }
+                    else {
+                        i++;
+                    }
+                }
+            }
+
+            // Get the registration of a socket. nullptr if it is not added.
+            Registration* find(Socket& sock) noexcept {
+                int fd = sock.getSocket();
+
+                if(fd < 0 || (size_t) fd >= mRegistrations.size()) {
+                    return nullptr;
+                }
+                return mRegistrations[fd];
+            }
+
+            // Update in fallback mode.
+            void updateFallback() {
+                mFallback->update();
+
+                for(auto& i : mFallbackReadable) {
+                    Registration* registration = find(*i);
+
+                    if(registration == nullptr) {
+                        continue;
+                    }
+
+                    if(!registration->socket->drain(*registration->buffer)) { //stop watching, like the multishot receive stops
+                        registration->closed = true;
+                        mFallback->remove(*registration->socket);
+                    }
+
+                    if(!registration->removed) {
+                        report(registration);
+                    }
+                }
+
+                collect();
+            }
+
+            int mRing; //io_uring instance, -1 in fallback mode
+            char* mRingMemory; //submission and completion rings
+            size_t mRingSize;
+            io_uring_sqe* mSqes; //submission queue entries
+            size_t mSqesSize;
+            unsigned int* mSqHead, *mSqTail, *mSqArray, *mCqHead, *mCqTail;
+            unsigned int mSqMask, mSqEntries, mCqMask, mSqLocalTail, mToSubmit;
+            io_uring_cqe* mCqes; //completion queue entries
+
+            io_uring_buf* mBufferRing; //provided buffer ring
+            size_t mBufferRingSize;
+            uint16_t* mBufferTail;
+            unsigned int mBufferCount, mBufferSize;
+            std::unique_ptr<char[]> mBufferMemory; //memory of the provided buffers
+
+            std::vector<Registration*> mRegistrations; //indexed by the file descriptor
+            std::vector<Registration*> mRemoved; //waiting for their last completions
+            std::vector<SendOperation*> mFreeSends; //reusable send operations
+            std::vector<Socket*>* mReadable; //pointer to user provided array
+            uint64_t mIteration; //number of updates
+            timeval mTimeout; //this store the timeout of update()
+
+            std::unique_ptr<EpollSelector> mFallback; //used when io_uring is not supported
+            std::vector<Socket*> mFallbackReadable;
+
+        protected:
+
+        public:
+            /*! \fn UringEngine(std::vector<Socket*>* readable, const unsigned int& entries = 256, const unsigned int& bufferCount = 1024, const unsigned int& bufferSize = 4096)
+                \brief Constructor. Falls back to an EpollSelector, if io_uring can not be used.
+                \param readable Array for the pointers of the sockets, which received data.
+                \param entries Size of the submission queue.
+                \param bufferCount Number of the provided receive buffers. It has to be a power of two,
+                    and at most 32768.
+                \param bufferSize Size of one provided receive buffer.*/
+            UringEngine(std::vector<Socket*>* readable, const unsigned int& entries = 256, const unsigned int& bufferCount = 1024, const unsigned int& bufferSize = 4096) :
+                mRing(-1),
+                mRingMemory(nullptr),
+                mRingSize(0),
+                mSqes(nullptr),
+                mSqesSize(0),
+                mSqHead(nullptr),
+                mSqTail(nullptr),
+                mSqArray(nullptr),
+                mCqHead(nullptr),
+                mCqTail(nullptr),
+                mSqMask(0),
+                mSqEntries(0),
+                mCqMask(0),
+                mSqLocalTail(0),
+                mToSubmit(0),
+                mCqes(nullptr),
+                mBufferRing(nullptr),
+                mBufferRingSize(0),
+                mBufferTail(nullptr),
+                mBufferCount(bufferCount),
+                mBufferSize(bufferSize),
+                mReadable(readable),
+                mIteration(0)
+            {
+                mTimeout.tv_sec = 0;
+                mTimeout.tv_usec = 0;
+
+                if(!initialize(entries)) {
+                    release();
+                    mBufferMemory.reset();
+                    mFallback.reset(new EpollSelector(&mFallbackReadable, nullptr, nullptr));
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The kernel refers to the memory of the engine.*/
+            UringEngine(const UringEngine& other) = delete;
+            UringEngine& operator=(const UringEngine& other) = delete;
+            UringEngine(UringEngine&& other) = delete;
+            UringEngine& operator=(UringEngine&& other) = delete;
+
+            /*! \fn ~UringEngine()
+                \brief Destructor. Cancels every pending operation, all sockets will be destroyed if it is necessary.*/
+            ~UringEngine() {
+                removeAll();
+
+                if(mRing != -1) {
+                    io_uring_getevents_arg argument;
+                    __kernel_timespec timeout;
+                    memset(&argument, 0, sizeof(argument));
+                    timeout.tv_sec = 0;
+                    timeout.tv_nsec = 10000000;
+                    argument.ts = (uint64_t) &timeout;
+
+                    for(int i = 0; i < 100 && !mRemoved.empty(); i++) {
+                        __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+                        if(Enter(mRing, mToSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument)) >= 0) {
+                            mToSubmit = 0;
+                        }
+                        reap();
+                        collect();
+                    }
+                }
+
+                release();
+
+                for(auto& i : mRemoved) { //the kernel did not answer, it will cancel them at closing
+                    for(auto& j : i->outbound) {
+                        delete j;
+                    }
+                    delete i->socket;
+                    delete i;
+                }
+                for(auto& i : mFreeSends) {
+                    delete i;
+                }
+            }
+
+            /*! \fn bool isUringActive()
+                \return true if io_uring is used, false if the engine fell back to EpollSelector*/
+            bool isUringActive() const noexcept {
+                return mRing != -1;
+            }
+
+            /*! \fn void update()
+                \brief Submits the queued operations, waits for completions, and fills
+                    the user provided array with the sockets which received data.*/
+            void update() {
+                mIteration++;
+
+                if(mReadable != nullptr) {
+                    mReadable->clear();
+                }
+
+                if(mFallback) {
+                    updateFallback();
+                    return;
+                }
+
+                __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+
+                io_uring_getevents_arg argument;
+                __kernel_timespec timeout;
+                memset(&argument, 0, sizeof(argument));
+                timeout.tv_sec = mTimeout.tv_sec;
+                timeout.tv_nsec = mTimeout.tv_usec * 1000;
+                argument.ts = (uint64_t) &timeout;
+
+                unsigned int minComplete = (*mCqHead == __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE)) ? 1 : 0;
+                bool timedOut = false;
+                int submitted;
+
+                if((submitted = Enter(mRing, mToSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument))) == -1) {
+                    if(errno == ETIME) {
+                        timedOut = true;
+                    }
+                    else if(errno != EINTR) {
+                        gCommonErrorFunction(ERROR_SELECTOR_FAIL, "Selector error.");
+                        return;
+                    }
+                }
+                else {
+                    mToSubmit -= submitted;
+                }
+
+                if(*mCqHead == __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE)) {
+                    if(timedOut) {
+                        gCommonErrorFunction(ERROR_SELECTOR_TIMEOUT, "Selector timed out.");
+                    }
+                    return;
+                }
+
+                reap();
+                collect();
+            }
+
+            /*! \fn void add(SocketType& sock, PacketBuffer& buffer)
+                \brief Adds a socket to the engine, and starts receiving on it.
+                \param sock The socket which will be stored.
+                \param buffer The received packets of the socket will be built here.
+                    It has to be valid until the socket is removed. If it is full, the common error
+                    callback is called with ERROR_PACKETBUFFER_TOO_SMALL and the rest of the bytes is dropped.
+                \tparam SocketType The type of the socket*/
+            template<typename SocketType>
+            void add(SocketType& sock, PacketBuffer& buffer) {
+                int fd = sock.getSocket();
+
+                if(fd < 0) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not add a socket.");
+                    return;
+                }
+
+                if((size_t) fd >= mRegistrations.size()) {
+                    mRegistrations.resize(fd + 1, nullptr);
+                }
+
+                if(mRegistrations[fd] != nullptr) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector could not add a socket.");
+                    return;
+                }
+
+                int type = 0;
+                socklen_t typeLength = sizeof(type);
+                ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLength);
+
+                Registration* registration = new Registration;
+                registration->socket = new SocketType(sock);
+                registration->buffer = &buffer;
+                registration->inFlight = 0;
+                registration->reported = 0;
+                registration->datagram = (type == SOCK_DGRAM);
+                registration->armed = false;
+                registration->closed = false;
+                registration->removed = false;
+
+                mRegistrations[fd] = registration;
+
+                if(mFallback) {
+                    mFallback->add(sock);
+                }
+                else {
+                    armReceive(registration);
+                }
+            }
+
+            /*! \fn void remove(Socket& sock)
+                \brief Removes a socket and cancels its operations. If the socket does not have
+                    more reference, it will be destroyed after the kernel finished with it.
+                \param sock The socket which will be removed.*/
+            void remove(Socket& sock) noexcept {
+                Registration* registration = find(sock);
+
+                if(registration == nullptr) {
+                    return;
+                }
+
+                mRegistrations[sock.getSocket()] = nullptr;
+                registration->removed = true;
+
+                if(mFallback) {
+                    mFallback->remove(sock);
+                }
+                else if(registration->armed) {
+                    io_uring_sqe* sqe = getSqe();
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd = -1;
+                    sqe->addr = (uint64_t) registration | TAG_RECEIVE;
+                    sqe->user_data = TAG_CANCEL;
+                }
+
+                mRemoved.push_back(registration);
+            }
+
+            /*! \fn void removeAll()
+                \brief Removes all socket from the engine.*/
+            void removeAll() noexcept {
+                for(auto& i : mRegistrations) {
+                    if(i != nullptr) {
+                        remove(*i->socket);
+                    }
+                }
+            }
+
+            /*! \fn void send(Socket& sock, const Packet& packet)
+                \brief Sends a packet on an added socket. With io_uring the packet is copied
+                    and submitted at the next update(). A socket has one send in flight, the next
+                    packets wait for it in order. UDP sockets send it to their stored address.
+                    Nothing is sent on a socket which hung up or failed.
+                    In fallback mode it is the same as sock.send(packet).
+                \param sock An added socket.
+                \param packet*/
+            void send(Socket& sock, const Packet& packet) {
+                Registration* registration = find(sock);
+
+                if(registration == nullptr) {
+                    gCommonErrorFunction(ERROR_SELECTOR_CONTROL, "Selector does not contain the socket.");
+                    return;
+                }
+
+                if(registration->closed) { //already reported
+                    return;
+                }
+
+                if(mFallback) {
+                    registration->socket->send(packet);
+                    return;
+                }
+
+                SendOperation* operation;
+                if(mFreeSends.empty()) {
+                    operation = new SendOperation;
+                }
+                else {
+                    operation = mFreeSends.back();
+                    mFreeSends.pop_back();
+                }
+
+                operation->owner = registration;
+                operation->bytes.clear();
+                packet.serialize(operation->bytes);
+                operation->offset = 0;
+
+                memset(&operation->message, 0, sizeof(msghdr));
+                operation->message.msg_iov = &operation->vector;
+                operation->message.msg_iovlen = 1;
+
+                if(registration->datagram) {
+                    Address& address = registration->socket->getAddress();
+                    operation->message.msg_name = address.toSockaddr();
+                    operation->message.msg_namelen = address.isIPv6() ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+                }
+
+                registration->outbound.push_back(operation);
+                if(registration->outbound.size() == 1) {
+                    submitSend(operation);
+                }
+            }
+
+            /*! \fn PacketBuffer& getBuffer(Socket& sock)
+                \param sock An added socket, for example from the readable array.
+                \return the buffer which was given at add()*/
+            PacketBuffer& getBuffer(Socket& sock) noexcept {
+                return *find(sock)->buffer;
+            }
+
+            /*! \fn void setTimeout(const timeval& timeout)
+                \brief Set timeout for update() method.
+                \param timeout A reference to a timeval variable which will be copied.*/
+            void setTimeout(const timeval& timeout) noexcept {
+                mTimeout = timeout;
+
+                if(mFallback) {
+                    mFallback->setTimeout(timeout);
+                }
+            }
+
+            /*! \fn void setTimeout(const int& sec, const int& usec)
+                \brief Set timeout for update() method.
+                \param sec Seconds.
+                \param usec Microseconds.*/
+            void setTimeout(const int& sec, const int& usec) noexcept {
+                mTimeout.tv_sec = sec;
+                mTimeout.tv_usec = usec;
+
+                if(mFallback) {
+                    mFallback->setTimeout(sec, usec);
+                }
+            }
+    };
+}//tnnf
+
+#endif
@@ -0,0 +1,392 @@
+/*! \file WorkerPool.hpp
+    \brief Work-stealing threads, which handle the packets of the event loops.*/
+
+/*
+Copyright (c) 2015 Máté Vágó
+
+This software is provided 'as-is', without any express or implied
+warranty. In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgement in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef TNNF_WORKERPOOL_HPP
+#define TNNF_WORKERPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "EpollSelector.hpp"
+#include "MpscQueue.hpp"
+#include "Packet.hpp"
+#include "Socket.hpp"
+
+namespace tnnf {
+    /*! \class PacketReply
+        \brief The way back to the loop which received a packet. It is given to the
+            handler of the WorkerPool.*/
+    class PacketReply {
+        private:
+            EpollSelector* mSelector; //the owning loop
+            SocketHandle mHandle; //the socket which received the packet
+
+        protected:
+
+        public:
+            PacketReply() noexcept :
+                mSelector(nullptr),
+                mHandle(0)
+            {
+
+            }
+
+            PacketReply(EpollSelector& selector, const SocketHandle& handle) noexcept :
+                mSelector(&selector),
+                mHandle(handle)
+            {
+
+            }
+
+            /*! \fn void send(const Packet& packet)
+                \brief Posts the packet to the loop, which sends it with EpollSelector::send(),
+                    so the worker never touches the socket. It is dropped if the socket
+                    has been removed since. It can be called from any thread, any number of times.
+                \param packet*/
+            void send(const Packet& packet) const {
+                EpollSelector* selector = mSelector;
+                SocketHandle handle = mHandle;
+
+                selector->post([selector, handle, packet]() {
+                    if(Socket* sock = selector->find(handle)) {
+                        selector->send(*sock, packet);
+                    }
+                });
+            }
+
+            /*! \fn EpollSelector& getSelector()
+                \return the owning loop. Use it only through EpollSelector::post().*/
+            EpollSelector& getSelector() const noexcept {
+                return *mSelector;
+            }
+
+            /*! \fn SocketHandle getHandle()
+                \return the handle of the socket in the owning loop*/
+            const SocketHandle& getHandle() const noexcept {
+                return mHandle;
+            }
+    };
+
+    typedef std::function<void(Packet&, PacketReply&)> PacketHandler; //called on a worker thread
+
+    /*! \class Strand
+        \brief The packets of one connection. They are handled one after the other, in the
+            order of WorkerPool::submit(), but not always on the same thread.
+            Make one for every connection with WorkerPool::makeStrand().*/
+    class Strand {
+        private:
+            friend class WorkerPool;
+
+            // A submitted packet.
+            struct Job {
+                Packet packet;
+                PacketReply reply;
+            };
+
+            MpscQueue<Job> mJobs;
+            std::atomic<size_t> mCount; //submitted and not handled jobs, the strand is scheduled while it is not 0
+
+        protected:
+
+        public:
+            Strand() : mCount(0) {}
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. It is shared by the workers.*/
+            Strand(const Strand& other) = delete;
+            Strand& operator=(const Strand& other) = delete;
+            Strand(Strand&& other) = delete;
+            Strand& operator=(Strand&& other) = delete;
+
+            /*! \fn size_t getCount()
+                \return the number of packets which are waiting or being handled*/
+            size_t getCount() const noexcept {
+                return mCount.load(std::memory_order_relaxed);
+            }
+    };
+
+    /*! \class WorkerPool
+        \brief Threads which handle the packets received by the event loops, so an expensive
+            handler does not stall the other connections of the loop.
+
+        Every worker has its own queue of strands. A strand is scheduled once, when its first
+        packet is submitted, and it stays scheduled until all of its packets are handled, so the
+        packets of a connection are never handled at the same time. A worker without work steals
+        the strand from the others which their owner would take last. A strand is handed back
+        after BATCH packets, to the end of the queue which its owner reaches last, so a busy
+        connection can not hold a worker forever.
+
+        The handler can answer through the PacketReply, which is sent by the loop of the socket:
+        \code
+        tnnf::WorkerPool workers([](tnnf::Packet& packet, tnnf::PacketReply& reply) {
+            reply.send(tnnf::Packet(packet.getType(), compute(packet.getData()))); //heavy work
+        });
+        workers.start();
+
+        selector.add(client, tnnf::SocketHandlers{[&](tnnf::Socket& sock) {
+            if(!sock.drain(buffer)) {
+                selector.remove(sock);
+                return;
+            }
+
+            while(buffer.isPacketStored()) {
+                workers.submit(strand, selector, sock, buffer.getPacket());
+            }
+        }});
+        \endcode*/
+    class WorkerPool {
+        private:
+            static const size_t BATCH = 16; //packets of a strand before it is handed back
+
+            /* Scheduled strands of a worker. The owner takes from the back, the thieves from the front,
+               where the handed back strands are put.*/
+            struct Worker {
+                std::mutex mutex;
+                std::deque<std::shared_ptr<Strand>> strands;
+                std::thread thread;
+            };
+
+            // The pool and the index of the worker on the current thread.
+            struct Current {
+                const WorkerPool* pool;
+                size_t index;
+            };
+
+            static Current& getCurrent() noexcept {
+                thread_local Current current = { nullptr, 0 };
+                return current;
+            }
+
+            // Put a strand to a queue, and wake up a sleeping worker.
+            void schedule(const std::shared_ptr<Strand>& strand, const bool& front) {
+                Current& current = getCurrent();
+                size_t index = current.pool == this ? current.index : mNext.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+                Worker& worker = *mWorkers[index];
+
+                mPending.fetch_add(1, std::memory_order_seq_cst); //before a worker can take it, so it never goes below 0
+                try {
+                    std::lock_guard<std::mutex> lock(worker.mutex);
+
+                    if(front) {
+                        worker.strands.push_front(strand);
+                    }
+                    else {
+                        worker.strands.push_back(strand);
+                    }
+                }
+                catch(...) {
+                    mPending.fetch_sub(1, std::memory_order_relaxed);
+                    throw;
+                }
+
+                if(mSleeping.load(std::memory_order_seq_cst) > 0) {
+                    std::lock_guard<std::mutex> lock(mSleepMutex);
+                    mWakeup.notify_one();
+                }
+            }
+
+            // Take a strand from the own queue, or steal one.
+            bool take(const size_t& index, std::shared_ptr<Strand>& strand) {
+                for(size_t i = 0; i < mWorkers.size(); i++) {
+                    Worker& worker = *mWorkers[(index + i) % mWorkers.size()];
+                    std::lock_guard<std::mutex> lock(worker.mutex);
+
+                    if(worker.strands.empty()) {
+                        continue;
+                    }
+
+                    if(i == 0) {
+                        strand = std::move(worker.strands.back());
+                        worker.strands.pop_back();
+                    }
+                    else {
+                        strand = std::move(worker.strands.front());
+                        worker.strands.pop_front();
+                    }
+
+                    mPending.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                return false;
+            }
+
+            // Handle at most BATCH packets of a strand, and schedule it again if it has more.
+            void handle(const std::shared_ptr<Strand>& strand) {
+                Strand::Job job;
+
+                for(size_t i = 0; i < BATCH; i++) {
+                    while(!strand->mJobs.pop(job)) { //submit() is between its count and its link
+                        std::this_thread::yield();
+                    }
+
+                    mHandler(job.packet, job.reply);
+
+                    if(strand->mCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        return;
+                    }
+                }
+
+                schedule(strand, true); //behind the other strands of this worker
+            }
+
+            // The loop of a worker thread.
+            void run(const size_t& index) {
+                std::shared_ptr<Strand> strand;
+                getCurrent().pool = this;
+                getCurrent().index = index;
+
+                while(mRunning.load(std::memory_order_acquire)) {
+                    if(take(index, strand)) {
+                        handle(strand);
+                        strand.reset();
+                        continue;
+                    }
+
+                    std::unique_lock<std::mutex> lock(mSleepMutex);
+                    mSleeping.fetch_add(1, std::memory_order_seq_cst);
+                    while(mPending.load(std::memory_order_seq_cst) == 0 && mRunning.load(std::memory_order_acquire)) {
+                        mWakeup.wait(lock);
+                    }
+                    mSleeping.fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
+
+            std::vector<std::unique_ptr<Worker>> mWorkers;
+            PacketHandler mHandler;
+            std::atomic<size_t> mNext; //queue of the next strand scheduled from outside
+            std::atomic<size_t> mPending; //scheduled strands in the queues
+            std::atomic<size_t> mSleeping; //workers waiting for mWakeup
+            std::atomic<bool> mRunning;
+            std::mutex mSleepMutex;
+            std::condition_variable mWakeup;
+
+        protected:
+
+        public:
+            /*! \fn WorkerPool(const PacketHandler& handler, size_t count = 0)
+                \brief Constructor. The threads are started by start().
+                \param handler Called for every submitted packet on a worker thread.
+                    It is called for several connections at the same time, so it has to be thread safe.
+                \param count Number of workers. 0 means one for every core.*/
+            explicit WorkerPool(const PacketHandler& handler, size_t count = 0) :
+                mHandler(handler),
+                mNext(0),
+                mPending(0),
+                mSleeping(0),
+                mRunning(false)
+            {
+                if(count == 0) {
+                    count = std::max(1u, std::thread::hardware_concurrency());
+                }
+
+                for(size_t i = 0; i < count; i++) {
+                    mWorkers.emplace_back(new Worker());
+                }
+            }
+
+            /*! \fn Copy and Move constructors and assignments
+                \brief Copy and move methods deleted. The threads refer to the WorkerPool.*/
+            WorkerPool(const WorkerPool& other) = delete;
+            WorkerPool& operator=(const WorkerPool& other) = delete;
+            WorkerPool(WorkerPool&& other) = delete;
+            WorkerPool& operator=(WorkerPool&& other) = delete;
+
+            /*! \fn ~WorkerPool()
+                \brief Destructor. Stops the threads.*/
+            ~WorkerPool() {
+                stop();
+            }
+
+            /*! \fn void start()
+                \brief Starts the worker threads.*/
+            void start() {
+                if(mRunning.exchange(true)) {
+                    return;
+                }
+
+                for(size_t i = 0; i < mWorkers.size(); i++) {
+                    mWorkers[i]->thread = std::thread(&WorkerPool::run, this, i);
+                }
+            }
+
+            /*! \fn void stop()
+                \brief Stops the workers after their current packet, and waits for the threads.
+                    The packets which are not handled yet stay in their strands.*/
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock(mSleepMutex);
+                    mRunning.store(false, std::memory_order_release);
+                    mWakeup.notify_all();
+                }
+
+                for(auto& i : mWorkers) {
+                    if(i->thread.joinable()) {
+                        i->thread.join();
+                    }
+                }
+            }
+
+            /*! \fn std::shared_ptr<Strand> makeStrand()
+                \brief Keep it with the connection, for example next to its PacketBuffer.
+                    The workers hold it while it has packets, so it can be released after
+                    the connection is closed.
+                \return a new strand*/
+            std::shared_ptr<Strand> makeStrand() const {
+                return std::make_shared<Strand>();
+            }
+
+            /*! \fn void submit(const std::shared_ptr<Strand>& strand, EpollSelector& selector, Socket& sock, Packet packet)
+                \brief Hands a packet over to the workers. Call it on the thread of the selector.
+                    It does not lock if the strand has packets already, otherwise the strand is
+                    put to the queue of a worker.
+                \param strand The strand of the connection.
+                \param selector The loop of the socket, the PacketReply posts to it.
+                \param sock A socket of the selector.
+                \param packet*/
+            void submit(const std::shared_ptr<Strand>& strand, EpollSelector& selector, Socket& sock, Packet packet) {
+                Strand::Job job;
+                job.packet = std::move(packet);
+                job.reply = PacketReply(selector, selector.getHandle(sock));
+
+                strand->mJobs.push(std::move(job));
+                if(strand->mCount.fetch_add(1, std::memory_order_acq_rel) == 0) {
+                    schedule(strand, false);
+                }
+            }
+
+            /*! \fn size_t getCount()
+                \return the number of workers*/
+            size_t getCount() const noexcept {
+                return mWorkers.size();
+            }
+    };
+}//tnnf
+
+#endif
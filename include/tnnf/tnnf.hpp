@@ -35,8 +35,15 @@ namespace tnnf {
     const uint32_t ERROR_SELECTOR_FAIL = 300;        //! \var const uint32_t ERROR_SELECTOR_FAIL
     const uint32_t ERROR_SELECTOR_TIMEOUT = 301;     //! \var const uint32_t ERROR_SELECTOR_TIMEOUT
     const uint32_t ERROR_SELECTOR_NO_TARGET = 302;   //! \var const uint32_t ERROR_SELECTOR_NO_TARGET
+    const uint32_t ERROR_SELECTOR_CREATE = 303;      //! \var const uint32_t ERROR_SELECTOR_CREATE
+    const uint32_t ERROR_SELECTOR_CONTROL = 304;     //! \var const uint32_t ERROR_SELECTOR_CONTROL
+
+    const uint32_t ERROR_HANDOVER_CREATE = 400;      //! \var const uint32_t ERROR_HANDOVER_CREATE
+    const uint32_t ERROR_HANDOVER_TRANSFER = 401;    //! \var const uint32_t ERROR_HANDOVER_TRANSFER
 
     const uint32_t ERROR_PACKET_TOO_BIG = 200;   //! \var const uint32_t ERROR_PACKET_TOO_BIG
+    const uint32_t ERROR_PACKET_UNKNOWN_TYPE = 201;  //! \var const uint32_t ERROR_PACKET_UNKNOWN_TYPE
+    const uint32_t ERROR_PACKET_INVALID_SIZE = 202;  //! \var const uint32_t ERROR_PACKET_INVALID_SIZE
     const uint32_t ERROR_PACKETBUFFER_TOO_SMALL = 250;   //! \var const uint32_t ERROR_PACKETBUFFER_TOO_SMALL
 
 
@@ -0,0 +1,33 @@
+/*! \file Check.hpp
+    \brief The checks of the tests, a failed check is printed and the test returns 1.*/
+
+#ifndef TNNF_TESTS_CHECK_HPP
+#define TNNF_TESTS_CHECK_HPP
+
+#include <cstdio>
+
+namespace check {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline int result(const char* test) {
+        if(failures() == 0) {
+            std::printf("%s: ok\n", test);
+            return 0;
+        }
+        std::printf("%s: %d checks failed\n", test, failures());
+        return 1;
+    }
+}//check
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            check::failures()++; \
+        } \
+    } while(0)
+
+#endif
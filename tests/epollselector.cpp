@@ -0,0 +1,166 @@
+/*
+    EpollSelector: the write interest of send() and the spin budget.
+*/
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../include/tnnf/EpollSelector.hpp"
+#include "../include/tnnf/TcpSocket.hpp"
+#include "Check.hpp"
+
+namespace {
+    std::vector<uint32_t> errors; //codes of the common error callback
+
+    void OnError(const uint32_t& errorCode, const char*) {
+        errors.push_back(errorCode);
+    }
+
+    size_t countErrors(const uint32_t& errorCode) {
+        size_t count = 0;
+        for(auto& i : errors) {
+            count += i == errorCode;
+        }
+        return count;
+    }
+
+    // Send big packets until the kernel does not take them at once.
+    void fill(tnnf::EpollSelector& selector, tnnf::Socket& sock) {
+        tnnf::Packet packet(1, std::string(60000, 'x'));
+
+        for(int i = 0; i < 100 && selector.getPendingSize(sock) == 0; i++) {
+            CHECK(selector.send(sock, packet));
+        }
+        CHECK(selector.getPendingSize(sock) > 0);
+    }
+
+    // Read the peer until the queue of send() is drained.
+    void drain(tnnf::EpollSelector& selector, tnnf::Socket& sock, const int& peer) {
+        char bytes[65536];
+
+        for(int i = 0; i < 1000 && selector.getPendingSize(sock) > 0; i++) {
+            while(recv(peer, bytes, sizeof(bytes), MSG_DONTWAIT) > 0) {}
+            selector.update();
+        }
+        CHECK(selector.getPendingSize(sock) == 0);
+    }
+
+    void checkHandlers() {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        tnnf::EpollSelector selector(nullptr, nullptr, nullptr);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+        int writable = 0;
+
+        selector.setTimeout(0, 10000);
+        selector.add(sock, tnnf::SocketHandlers{nullptr, [&writable](tnnf::Socket&) { writable++; }, nullptr});
+
+        selector.update();
+        CHECK(writable == 1); //connected
+
+        //sent at once: onWritable is not called again
+        CHECK(selector.send(sock, tnnf::Packet(1, "small")));
+        selector.update();
+        selector.update();
+        CHECK(writable == 1);
+
+        //queued: onWritable is called once, when it is drained
+        fill(selector, sock);
+        drain(selector, sock, fds[1]);
+        selector.update();
+        CHECK(writable == 2);
+
+        selector.removeAll();
+        close(fds[1]);
+    }
+
+    void checkArray() {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        std::vector<tnnf::Socket*> writable;
+        tnnf::EpollSelector selector(nullptr, &writable, nullptr);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+
+        selector.setTimeout(0, 10000);
+        selector.add(sock);
+
+        //an idle socket is not reported, the wait is not cut short
+        selector.update();
+        CHECK(writable.empty());
+
+        fill(selector, sock);
+        selector.update();
+        CHECK(writable.empty());
+
+        size_t reported = 0;
+        char bytes[65536];
+        for(int i = 0; i < 1000 && selector.getPendingSize(sock) > 0; i++) {
+            while(recv(fds[1], bytes, sizeof(bytes), MSG_DONTWAIT) > 0) {}
+            selector.update();
+            reported += writable.size();
+        }
+        CHECK(selector.getPendingSize(sock) == 0);
+        CHECK(reported == 1); //when the queue is drained
+
+        selector.update();
+        CHECK(writable.empty());
+
+        selector.removeAll();
+        close(fds[1]);
+    }
+
+    void checkSpin() {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        std::vector<tnnf::Socket*> readable;
+        tnnf::EpollSelector selector(&readable, nullptr, nullptr);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+        selector.add(sock);
+
+        //timeout 0: every update() spins for the budget, the empty ones are not timeouts
+        errors.clear();
+        selector.setTimeout(0, 0);
+        selector.setSpinBudget(2000);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int i = 0; i < 10; i++) {
+            selector.update();
+            CHECK(readable.empty());
+        }
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::microseconds(10 * 1500));
+        CHECK(countErrors(tnnf::ERROR_SELECTOR_TIMEOUT) == 0);
+
+        CHECK(write(fds[1], "x", 1) == 1);
+        selector.update();
+        CHECK(readable.size() == 1);
+
+        //a longer timeout is reported when it has elapsed
+        char byte;
+        CHECK(read(fds[0], &byte, 1) == 1);
+        selector.setTimeout(0, 5000);
+        selector.update();
+        CHECK(readable.empty());
+        CHECK(countErrors(tnnf::ERROR_SELECTOR_TIMEOUT) == 1);
+
+        selector.removeAll();
+        close(fds[1]);
+    }
+}
+
+int main() {
+    tnnf::SetCommonErrorCallback(OnError);
+
+    checkHandlers();
+    checkArray();
+    checkSpin();
+
+    return check::result("epollselector");
+}
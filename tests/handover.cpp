@@ -0,0 +1,170 @@
+/*
+    Handover: a connection with its pending bytes, the mode of the socket file,
+    and the descriptors of a broken transfer.
+*/
+
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/tnnf/Handover.hpp"
+#include "Check.hpp"
+
+namespace {
+    const char* PATH = "tnnf_test.handover";
+
+    std::vector<uint32_t> errors; //codes of the common error callback
+
+    void OnError(const uint32_t& errorCode, const char*) {
+        errors.push_back(errorCode);
+    }
+
+    size_t countDescriptors() {
+        size_t count = 0;
+        DIR* directory = opendir("/proc/self/fd");
+
+        while(directory != nullptr && readdir(directory) != nullptr) {
+            count++;
+        }
+        if(directory != nullptr) {
+            closedir(directory);
+        }
+        return count;
+    }
+
+    void checkConnection() {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        std::string bytes;
+        tnnf::Packet(1, "first").serialize(bytes);
+        tnnf::Packet(2, "second").serialize(bytes);
+
+        tnnf::PacketBuffer buffer;
+        memcpy(buffer.getWritable(), bytes.data(), bytes.size() - 3); //the second is incomplete
+        buffer.buildPackets(bytes.size() - 3);
+
+        tnnf::HandoverSender sender(PATH);
+        struct stat status;
+        CHECK(stat(PATH, &status) == 0 && (status.st_mode & 0777) == 0600);
+
+        {
+            tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+            sender.add(sock, buffer);
+        }
+
+        bool sent = false;
+        std::thread old([&sender, &sent]() {
+            sent = sender.send();
+        });
+
+        tnnf::HandoverReceiver receiver;
+        CHECK(receiver.receive(PATH));
+        old.join();
+        CHECK(sent);
+        CHECK(receiver.getConnections().size() == 1);
+        if(receiver.getConnections().size() != 1) {
+            return;
+        }
+
+        tnnf::HandoverReceiver::Connection& connection = receiver.getConnections()[0];
+        tnnf::PacketBuffer restored;
+        connection.restore(restored);
+        CHECK(restored.getNumOfStoredPackets() == 1);
+        CHECK(restored.getCurrentSize() == bytes.size() - 3 - 9);
+
+        CHECK(write(fds[1], bytes.data() + bytes.size() - 3, 3) == 3); //the rest arrives on the handed over socket
+        CHECK(connection.socket.drain(restored));
+        CHECK(restored.getNumOfStoredPackets() == 2);
+        CHECK(restored.getPacket().getData() == "first");
+        CHECK(restored.getPacket().getData() == "second");
+
+        //a buffer without room does not hang
+        errors.clear();
+        connection.pending = bytes;
+        tnnf::PacketBuffer failed(100);
+        connection.restore(failed);
+        CHECK(errors.size() == 1 && errors[0] == tnnf::ERROR_PACKETBUFFER_TOO_SMALL);
+
+        close(fds[1]);
+    }
+
+    // An old process which breaks after the descriptor of a connection, and after length bytes of the item.
+    void sendBroken(const int& listener, const size_t& length) {
+        int sock = accept(listener, nullptr, nullptr);
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        tnnf::HandoverHeader header = { htonl(tnnf::HANDOVER_CONNECTION), htonl(100) };
+        char item[sizeof(header) + 10];
+        memcpy(item, &header, sizeof(header));
+        memset(item + sizeof(header), 0, 10);
+
+        char control[CMSG_SPACE(sizeof(int))];
+        iovec vector = { item, length };
+        msghdr message;
+
+        memset(&message, 0, sizeof(message));
+        memset(control, 0, sizeof(control));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        cmsghdr* descriptor = CMSG_FIRSTHDR(&message);
+        descriptor->cmsg_level = SOL_SOCKET;
+        descriptor->cmsg_type = SCM_RIGHTS;
+        descriptor->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(descriptor), &fds[0], sizeof(int));
+
+        CHECK(sendmsg(sock, &message, 0) == (ssize_t) length);
+        close(sock);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    void checkBroken() {
+        const size_t lengths[] = {3, sizeof(tnnf::HandoverHeader) + 10}; //in the header, in the pending bytes
+
+        for(auto& i : lengths) {
+            sockaddr_un address;
+            int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+            unlink(PATH);
+            CHECK(tnnf::MakeHandoverAddress(PATH, address));
+            CHECK(bind(listener, (sockaddr*) &address, sizeof(address)) == 0);
+            CHECK(listen(listener, 1) == 0);
+
+            size_t before = countDescriptors();
+            std::thread old(sendBroken, listener, i);
+
+            tnnf::HandoverReceiver receiver;
+            errors.clear();
+            CHECK(!receiver.receive(PATH));
+            old.join();
+
+            CHECK(errors.size() == 1 && errors[0] == tnnf::ERROR_HANDOVER_TRANSFER);
+            CHECK(receiver.getConnections().empty());
+            CHECK(countDescriptors() == before); //the received descriptor is closed
+
+            close(listener);
+            unlink(PATH);
+        }
+    }
+}
+
+int main() {
+    tnnf::SetCommonErrorCallback(OnError);
+    tnnf::SetSocketErrorCallback([](tnnf::Socket&, const uint32_t&, int&) {});
+
+    checkConnection();
+    checkBroken();
+
+    return check::result("handover");
+}
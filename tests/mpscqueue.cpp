@@ -0,0 +1,119 @@
+/*
+    MpscQueue and EpollSelector::post(): many producers, no value is lost or reordered,
+    and a loop which waits without a timeout is always woken up.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../include/tnnf/EpollSelector.hpp"
+#include "../include/tnnf/MpscQueue.hpp"
+#include "Check.hpp"
+
+namespace {
+    const size_t PRODUCERS = 8;
+
+    std::vector<uint32_t> errors; //codes of the common error callback
+
+    void OnError(const uint32_t& errorCode, const char*) {
+        errors.push_back(errorCode);
+    }
+
+    void checkQueue() {
+        const size_t count = 100000; //values of a producer
+        tnnf::MpscQueue<uint64_t> queue;
+        std::vector<std::thread> producers;
+
+        CHECK(queue.isEmpty());
+        for(size_t i = 0; i < PRODUCERS; i++) {
+            producers.emplace_back([&queue, i, count]() {
+                for(uint64_t value = 0; value < count; value++) {
+                    queue.push(i << 32 | value);
+                }
+            });
+        }
+
+        //the values of a producer arrive in order
+        std::vector<uint64_t> next(PRODUCERS, 0);
+        size_t popped = 0, unordered = 0;
+        uint64_t value;
+
+        for(size_t spins = 0; popped < PRODUCERS * count && spins < 100000000; spins++) {
+            if(!queue.pop(value)) {
+                continue;
+            }
+
+            unordered += (value & 0xffffffff) != next[value >> 32]++;
+            popped++;
+        }
+        for(auto& i : producers) {
+            i.join();
+        }
+
+        CHECK(popped == PRODUCERS * count);
+        CHECK(unordered == 0);
+        CHECK(!queue.pop(value));
+        CHECK(queue.isEmpty());
+    }
+
+    void checkPost() {
+        const size_t count = 20000; //tasks of a producer
+        std::vector<tnnf::Socket*> readable;
+        tnnf::EpollSelector selector(&readable, nullptr, nullptr);
+        selector.setTimeout(-1, 0); //only a post() can wake it up
+
+        std::vector<size_t> next(PRODUCERS, 0); //used on the thread of the loop
+        std::atomic<size_t> handled(0);
+        size_t unordered = 0;
+
+        errors.clear();
+        std::thread loop([&selector]() {
+            selector.run();
+        });
+
+        std::vector<std::thread> producers;
+        for(size_t i = 0; i < PRODUCERS; i++) {
+            producers.emplace_back([&, i]() {
+                for(size_t task = 0; task < count; task++) {
+                    selector.post([&, i, task]() {
+                        unordered += task != next[i]++;
+                        handled.fetch_add(1, std::memory_order_release);
+                    });
+
+                    if(task % 1000 == 0) { //the loop goes to sleep in between
+                        std::this_thread::sleep_for(std::chrono::microseconds(200));
+                    }
+                }
+            });
+        }
+        for(auto& i : producers) {
+            i.join();
+        }
+
+        //a lost wakeup leaves the last tasks in the queue while the loop sleeps
+        for(int i = 0; i < 5000 && handled.load(std::memory_order_acquire) < PRODUCERS * count; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(handled.load(std::memory_order_acquire) == PRODUCERS * count);
+
+        selector.stop();
+        loop.join();
+
+        CHECK(unordered == 0);
+        CHECK(errors.empty());
+    }
+}
+
+int main() {
+    tnnf::SetCommonErrorCallback(OnError);
+
+    for(int i = 0; i < 5; i++) {
+        checkQueue();
+        checkPost();
+    }
+
+    return check::result("mpscqueue");
+}
@@ -0,0 +1,280 @@
+/*
+    PacketBuffer: packets split at every byte, invalid sizes, the views, the pooled and the elastic buffers.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/tnnf/PacketBuffer.hpp"
+#include "Check.hpp"
+
+namespace {
+    std::vector<uint32_t> errors; //codes of the common error callback
+
+    void OnError(const uint32_t& errorCode, const char*) {
+        errors.push_back(errorCode);
+    }
+
+    // The bytes of the packets, as they are sent.
+    std::string stream(const std::vector<tnnf::Packet>& packets) {
+        std::string bytes;
+        for(auto& i : packets) {
+            i.serialize(bytes);
+        }
+        return bytes;
+    }
+
+    std::vector<tnnf::Packet> samples() {
+        std::vector<tnnf::Packet> packets;
+        packets.push_back(tnnf::Packet(1, "a"));
+        packets.push_back(tnnf::Packet(2, ""));
+        packets.push_back(tnnf::Packet(3, std::string(1000, 'b')));
+        packets.push_back(tnnf::Packet(4, std::string(60000, 'c')));
+        packets.push_back(tnnf::Packet(5, "de"));
+        return packets;
+    }
+
+    // Receive the bytes in pieces of at most chunk bytes, like short reads of a stream.
+    void feed(tnnf::PacketBuffer& buffer, const std::string& bytes, const size_t& chunk) {
+        size_t position = 0;
+
+        while(position < bytes.size()) {
+            size_t length = std::min(std::min(chunk, bytes.size() - position), buffer.getWritableSize());
+            CHECK(length > 0);
+            if(length == 0) {
+                return;
+            }
+
+            memcpy(buffer.getWritable(), bytes.data() + position, length);
+            buffer.buildPackets(length);
+            position += length;
+        }
+    }
+
+    bool same(const tnnf::Packet& a, const tnnf::Packet& b) {
+        return a.getType() == b.getType() && a.getSize() == b.getSize() && a.getData() == b.getData();
+    }
+
+    void checkPackets(tnnf::PacketBuffer& buffer, const std::vector<tnnf::Packet>& expected) {
+        CHECK(buffer.getNumOfStoredPackets() == expected.size());
+
+        for(auto& i : expected) {
+            if(!buffer.isPacketStored()) {
+                return;
+            }
+            CHECK(same(buffer.getPacket(), i));
+        }
+        CHECK(!buffer.isPacketStored());
+        CHECK(buffer.getCurrentSize() == 0);
+    }
+
+    void checkSplit() {
+        std::vector<tnnf::Packet> packets = samples();
+        std::string bytes = stream(packets);
+
+        const size_t chunks[] = {1, 2, 3, 7, 1000, 65535};
+        for(auto& i : chunks) {
+            tnnf::PacketBuffer buffer;
+            feed(buffer, bytes, i);
+            checkPackets(buffer, packets);
+        }
+
+        //the same stream many times, so the cursors wrap around the end of the buffer
+        tnnf::PacketBuffer buffer;
+        for(int i = 0; i < 20; i++) {
+            feed(buffer, bytes, 4099);
+            checkPackets(buffer, packets);
+        }
+    }
+
+    void checkCallback() {
+        std::vector<tnnf::Packet> packets = samples();
+        std::vector<tnnf::Packet> built;
+        tnnf::PacketBuffer buffer;
+        std::string bytes = stream(packets);
+
+        memcpy(buffer.getWritable(), bytes.data(), 1500); //the first three and a part of the fourth
+        buffer.buildPackets(1500, [&built](tnnf::Packet& packet) {
+            built.push_back(packet);
+        });
+        CHECK(built.size() == 3);
+        CHECK(!buffer.isPacketStored());
+        CHECK(buffer.getCurrentSize() == 1500 - stream(std::vector<tnnf::Packet>(packets.begin(), packets.begin() + 3)).size());
+
+        feed(buffer, bytes.substr(1500), 1 << 16);
+        checkPackets(buffer, std::vector<tnnf::Packet>(packets.begin() + 3, packets.end()));
+    }
+
+    void checkInvalidSize() {
+        tnnf::PacketBuffer buffer;
+        std::string bytes = stream(std::vector<tnnf::Packet>(1, tnnf::Packet(1, "ok")));
+
+        errors.clear();
+        bytes += std::string("\x00\x03\x00\x01garbage", 11); //size 3 is smaller than the header
+        feed(buffer, bytes, bytes.size());
+
+        CHECK(errors.size() == 1 && errors[0] == tnnf::ERROR_PACKET_INVALID_SIZE);
+        CHECK(buffer.getNumOfStoredPackets() == 1);
+        CHECK(buffer.getCurrentSize() == 0); //the rest is dropped
+        buffer.getPacket();
+
+        //the next valid packet is read again
+        std::vector<tnnf::Packet> packets = samples();
+        feed(buffer, stream(packets), 100);
+        checkPackets(buffer, packets);
+        CHECK(errors.size() == 1);
+
+        //a buffer smaller than a packet is not made
+        tnnf::PacketBuffer small(100);
+        CHECK(small.getBuffer() == nullptr);
+        CHECK(small.getSize() == 0);
+    }
+
+    void checkViews() {
+        std::vector<tnnf::Packet> packets = samples();
+        std::string bytes = stream(packets);
+        tnnf::PacketBuffer buffer;
+
+        size_t length = bytes.size() - 1; //the last packet is incomplete
+        memcpy(buffer.getWritable(), bytes.data(), length);
+        buffer.commit(length);
+
+        size_t count = 0;
+        for(const tnnf::PacketView& view : buffer.getViews()) {
+            CHECK(view.type == packets[count].getType());
+            CHECK(std::string(view.data, view.size) == packets[count].getData());
+            count++;
+        }
+        CHECK(count == packets.size() - 1);
+
+        //consume until the second packet, the rest is seen again
+        tnnf::PacketBuffer::ViewIterator second = buffer.getViews().begin();
+        ++second;
+        buffer.consume(*second);
+        CHECK(buffer.getViews().begin()->type == packets[2].getType());
+
+        buffer.consume();
+        CHECK(buffer.getCurrentSize() == (size_t) packets.back().getSize() - 1);
+        CHECK(buffer.getViews().begin() == buffer.getViews().end());
+
+        memcpy(buffer.getWritable(), bytes.data() + length, 1);
+        buffer.buildPackets(1);
+        checkPackets(buffer, std::vector<tnnf::Packet>(1, packets.back()));
+    }
+
+    void checkPooled() {
+        tnnf::BufferPool pool;
+        std::vector<tnnf::Packet> packets = samples();
+        std::string bytes = stream(packets);
+
+        {
+            tnnf::PacketBuffer buffer(pool);
+            CHECK(buffer.getSize() == 0);
+
+            feed(buffer, bytes, bytes.size()); //complete packets are built in the scratch buffer
+            checkPackets(buffer, packets);
+            CHECK(pool.getBorrowed() == 0);
+            CHECK(buffer.getSize() == 0);
+
+            feed(buffer, bytes, 3); //every packet is split, the incomplete ones are borrowed
+            checkPackets(buffer, packets);
+            CHECK(pool.getBorrowed() == 0);
+        }
+
+        //many connections with a split packet, through the same scratch buffer
+        std::vector<tnnf::PacketBuffer> buffers(10, tnnf::PacketBuffer(pool));
+        std::string big = stream(std::vector<tnnf::Packet>(1, packets[3]));
+
+        for(auto& i : buffers) {
+            feed(i, big.substr(0, 20000), 20000);
+            CHECK(i.getCurrentSize() == 20000);
+            CHECK(i.getSize() >= big.size()); //it can hold the whole packet
+        }
+        CHECK(pool.getBorrowed() == buffers.size());
+
+        {
+            tnnf::PacketBuffer copy(buffers[0]);
+            tnnf::PacketBuffer moved(std::move(buffers[1]));
+            CHECK(pool.getBorrowed() == buffers.size() + 1);
+
+            feed(copy, big.substr(20000), 1 << 16);
+            checkPackets(copy, std::vector<tnnf::Packet>(1, packets[3]));
+            feed(moved, big.substr(20000), 1 << 16);
+            checkPackets(moved, std::vector<tnnf::Packet>(1, packets[3]));
+            CHECK(pool.getBorrowed() == buffers.size() - 1); //the moved one is given back, the others still wait
+        }
+
+        for(size_t i = 0; i < buffers.size(); i++) {
+            if(i != 1) {
+                feed(buffers[i], big.substr(20000), 1 << 16);
+                checkPackets(buffers[i], std::vector<tnnf::Packet>(1, packets[3]));
+            }
+        }
+        CHECK(pool.getBorrowed() == 0);
+
+        //an incomplete packet is given back when the buffer is destroyed
+        memcpy(buffers[0].getWritable(), big.data(), 10);
+        buffers[0].buildPackets(10);
+        CHECK(pool.getBorrowed() == 1);
+        buffers.clear();
+        CHECK(pool.getBorrowed() == 0);
+    }
+
+    void checkElastic() {
+        tnnf::PacketBuffer buffer(1024, 1 << 20);
+        CHECK(buffer.getSize() == 1024);
+
+        //a packet which does not fit grows the buffer at once
+        std::vector<tnnf::Packet> huge(1, tnnf::Packet(1, std::string(60000, 'h')));
+        feed(buffer, stream(huge), 1000);
+        checkPackets(buffer, huge);
+        CHECK(buffer.getSize() >= 60004);
+
+        //big packets: it grows to hold FRAMES_PER_READ of them
+        std::vector<tnnf::Packet> big(4, tnnf::Packet(2, std::string(8000, 'b')));
+        for(int i = 0; i < 50; i++) {
+            feed(buffer, stream(big), 1 << 20);
+            checkPackets(buffer, big);
+        }
+        CHECK(buffer.getEstimate() > 7000 && buffer.getEstimate() <= 8004);
+        CHECK(buffer.getSize() >= 8004 * tnnf::PacketBuffer::FRAMES_PER_READ);
+        CHECK(buffer.getSize() <= 1 << 20);
+
+        //small packets: it shrinks back to the smallest size, after SHRINK_AFTER calm reads
+        std::vector<tnnf::Packet> small(1, tnnf::Packet(3, "small"));
+        size_t reads = 0;
+        while(buffer.getSize() > 1024 && reads < 1000) {
+            feed(buffer, stream(small), 1 << 20);
+            checkPackets(buffer, small);
+            reads++;
+        }
+        CHECK(buffer.getSize() == 1024);
+        CHECK(reads >= tnnf::PacketBuffer::SHRINK_AFTER);
+
+        //the incomplete packet is kept through the resizes
+        std::string bytes = stream(big) + stream(huge) + stream(small);
+        feed(buffer, bytes, 777);
+        checkPackets(buffer, std::vector<tnnf::Packet>{big[0], big[1], big[2], big[3], huge[0], small[0]});
+
+        //the size of a fixed buffer does not change
+        tnnf::PacketBuffer fixed;
+        feed(fixed, bytes, 777);
+        CHECK(fixed.getSize() == tnnf::Packet::maxSize);
+    }
+}
+
+int main() {
+    tnnf::SetCommonErrorCallback(OnError);
+
+    checkSplit();
+    checkCallback();
+    checkInvalidSize();
+    checkViews();
+    checkPooled();
+    checkElastic();
+
+    return check::result("packetbuffer");
+}
@@ -0,0 +1,89 @@
+/*
+    Reactor: started again after a stop() from its handler, and destroyed on the thread of an other Reactor.
+*/
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../include/tnnf/ReactorGroup.hpp"
+#include "Check.hpp"
+
+namespace {
+    // Wait until the condition is true, at most for a second.
+    template<typename Condition>
+    bool wait(Condition condition) {
+        for(int i = 0; i < 1000 && !condition(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return condition();
+    }
+
+    void consume(tnnf::Socket& sock) {
+        char bytes[16];
+        CHECK(recv(sock.getSocket(), bytes, sizeof(bytes), 0) >= 0);
+    }
+
+    void checkRestart() {
+        std::atomic<int> calls(0);
+        tnnf::Reactor reactor([&calls](tnnf::Reactor& self, tnnf::Socket& sock) {
+            consume(sock);
+            calls++;
+            self.stop();
+        });
+
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+        reactor.add(sock);
+
+        reactor.start();
+        CHECK(write(fds[1], "x", 1) == 1);
+        CHECK(wait([&calls]() { return calls == 1; }));
+
+        reactor.start(); //the thread stopped by the handler is joined
+        CHECK(write(fds[1], "y", 1) == 1);
+        CHECK(wait([&calls]() { return calls == 2; }));
+
+        reactor.stop();
+        close(fds[1]);
+    }
+
+    void checkDestroyOnLoopThread() {
+        tnnf::Reactor* inner = new tnnf::Reactor([](tnnf::Reactor&, tnnf::Socket&) {});
+        std::atomic<bool> destroyed(false);
+
+        inner->start();
+        tnnf::Reactor outer([&inner, &destroyed](tnnf::Reactor&, tnnf::Socket& sock) {
+            consume(sock);
+            if(inner != nullptr) {
+                inner->stop(); //it does not wait on a loop thread, the destructor does
+                delete inner;
+                inner = nullptr;
+                destroyed = true;
+            }
+        });
+
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+        outer.add(sock);
+
+        outer.start();
+        CHECK(write(fds[1], "x", 1) == 1);
+        CHECK(wait([&destroyed]() { return destroyed.load(); }));
+
+        outer.stop();
+        close(fds[1]);
+    }
+}
+
+int main() {
+    checkRestart();
+    checkDestroyOnLoopThread();
+
+    return check::result("reactor");
+}
@@ -0,0 +1,76 @@
+/*
+    The cost of a wait of the BasicSelector backends with many idle sockets and a few active ones.
+    Usage: selector_benchmark [sockets] [active] [iterations]
+*/
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../include/tnnf/SelectorBackend.hpp"
+
+namespace {
+    template<typename Backend>
+    void run(const char* name, const std::vector<int>& descriptors, const size_t& iterations) {
+        Backend backend;
+        for(auto& i : descriptors) {
+            backend.add(i);
+        }
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        size_t reported = 0;
+        timeval timeout = {0, 0};
+
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < iterations; i++) {
+            if(backend.wait(&timeout) > 0) {
+                backend.forEachReady(descriptors, [&reported](const int&, const uint32_t&) {
+                    reported++;
+                });
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+        std::printf("%-8s %10.0f ns/wait %10zu ready\n", name, (double) elapsed.count() / iterations, reported);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t sockets = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 400; //select() is limited to FD_SETSIZE descriptors
+    size_t active = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+    size_t iterations = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10000;
+
+    std::vector<int> descriptors, remotes;
+    for(size_t i = 0; i < sockets; i++) {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            std::perror("socketpair");
+            return 1;
+        }
+        descriptors.push_back(fds[0]);
+        remotes.push_back(fds[1]);
+    }
+    for(size_t i = 0; i < active && i < sockets; i++) { //never read, so they stay readable
+        if(write(remotes[i * sockets / active], "x", 1) != 1) {
+            std::perror("write");
+            return 1;
+        }
+    }
+
+    std::printf("%zu sockets, %zu active, %zu waits\n", sockets, active, iterations);
+    if(descriptors.back() < FD_SETSIZE) {
+        run<tnnf::SelectBackend>("select", descriptors, iterations);
+    }
+    run<tnnf::PollBackend>("poll", descriptors, iterations);
+    run<tnnf::EpollBackend>("epoll", descriptors, iterations);
+
+    for(size_t i = 0; i < sockets; i++) {
+        close(descriptors[i]);
+        close(remotes[i]);
+    }
+    return 0;
+}
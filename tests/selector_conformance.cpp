@@ -0,0 +1,225 @@
+/*
+    The same checks on every backend of BasicSelector (tnnf/SelectorBackend.hpp),
+    with the sockets of socketpair().
+*/
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "../include/tnnf/SelectorBackend.hpp"
+#include "Check.hpp"
+
+namespace {
+    typedef std::vector<std::pair<int, uint32_t>> Ready;
+
+    struct Pair {
+        int local, remote;
+
+        Pair() {
+            int fds[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                fds[0] = fds[1] = -1;
+            }
+            local = fds[0];
+            remote = fds[1];
+        }
+
+        Pair(const Pair& other) = delete;
+        Pair& operator=(const Pair& other) = delete;
+
+        ~Pair() {
+            close(local);
+            if(remote != -1) {
+                close(remote);
+            }
+        }
+
+        void hangUp() {
+            close(remote);
+            remote = -1;
+        }
+    };
+
+    template<typename Backend>
+    Ready waitReady(Backend& backend, const std::vector<int>& descriptors, const long& microseconds = 100000) {
+        timeval timeout;
+        timeout.tv_sec = microseconds / 1000000;
+        timeout.tv_usec = microseconds % 1000000;
+
+        Ready ready;
+        if(backend.wait(&timeout) > 0) {
+            backend.forEachReady(descriptors, [&ready](const int& fd, const uint32_t& events) {
+                ready.push_back(std::make_pair(fd, events));
+            });
+        }
+        std::sort(ready.begin(), ready.end());
+        return ready;
+    }
+
+    uint32_t eventsOf(const Ready& ready, const int& fd) {
+        for(auto& i : ready) {
+            if(i.first == fd) {
+                return i.second;
+            }
+        }
+        return 0;
+    }
+
+    template<typename Backend>
+    void checkTimeout() {
+        Backend backend;
+        Pair pair;
+        std::vector<int> descriptors{pair.local};
+
+        CHECK(backend.add(pair.local));
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        timeval before, after;
+        gettimeofday(&before, nullptr);
+        CHECK(waitReady(backend, descriptors, 20000).empty());
+        gettimeofday(&after, nullptr);
+
+        long elapsed = (after.tv_sec - before.tv_sec) * 1000000 + (after.tv_usec - before.tv_usec);
+        CHECK(elapsed >= 15000);
+    }
+
+    template<typename Backend>
+    void checkReadable() {
+        Backend backend;
+        Pair quiet, loud;
+        std::vector<int> descriptors{quiet.local, loud.local};
+
+        CHECK(backend.add(quiet.local));
+        CHECK(backend.add(loud.local));
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        CHECK(write(loud.remote, "x", 1) == 1);
+        Ready ready = waitReady(backend, descriptors);
+        CHECK(ready.size() == 1);
+        CHECK(eventsOf(ready, loud.local) == tnnf::SELECTOR_READABLE);
+
+        //level triggered: reported until it is read
+        ready = waitReady(backend, descriptors);
+        CHECK(eventsOf(ready, loud.local) == tnnf::SELECTOR_READABLE);
+
+        char byte;
+        CHECK(read(loud.local, &byte, 1) == 1);
+        CHECK(waitReady(backend, descriptors, 10000).empty());
+    }
+
+    template<typename Backend>
+    void checkHangUp() {
+        Backend backend;
+        Pair pair;
+        std::vector<int> descriptors{pair.local};
+
+        CHECK(backend.add(pair.local));
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        pair.hangUp();
+        Ready ready = waitReady(backend, descriptors);
+        CHECK(eventsOf(ready, pair.local) & tnnf::SELECTOR_READABLE);
+    }
+
+    template<typename Backend>
+    void checkInterest() {
+        Backend backend;
+        Pair pair;
+        std::vector<int> descriptors{pair.local};
+
+        CHECK(backend.add(pair.local));
+        backend.setInterest(tnnf::SELECTOR_READABLE | tnnf::SELECTOR_WRITABLE, descriptors);
+        CHECK(eventsOf(waitReady(backend, descriptors), pair.local) == tnnf::SELECTOR_WRITABLE);
+
+        CHECK(write(pair.remote, "x", 1) == 1);
+        CHECK(eventsOf(waitReady(backend, descriptors), pair.local) == (tnnf::SELECTOR_READABLE | tnnf::SELECTOR_WRITABLE));
+
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+        CHECK(eventsOf(waitReady(backend, descriptors), pair.local) == tnnf::SELECTOR_READABLE);
+
+        backend.setInterest(0, descriptors);
+        CHECK(waitReady(backend, descriptors, 10000).empty());
+    }
+
+    template<typename Backend>
+    void checkRemove() {
+        Backend backend;
+        Pair first, second;
+        std::vector<int> descriptors{first.local, second.local};
+
+        CHECK(backend.add(first.local));
+        CHECK(backend.add(second.local));
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        CHECK(write(first.remote, "x", 1) == 1);
+        CHECK(write(second.remote, "x", 1) == 1);
+
+        timeval timeout = {0, 100000};
+        CHECK(backend.wait(&timeout) > 0);
+
+        //removed between wait() and forEachReady(), like a handler closing another socket
+        backend.remove(first.local);
+        descriptors.erase(descriptors.begin());
+
+        Ready ready;
+        backend.forEachReady(descriptors, [&ready](const int& fd, const uint32_t& events) {
+            ready.push_back(std::make_pair(fd, events));
+        });
+        CHECK(ready.size() == 1);
+        CHECK(eventsOf(ready, second.local) == tnnf::SELECTOR_READABLE);
+
+        ready = waitReady(backend, descriptors);
+        CHECK(ready.size() == 1);
+        CHECK(eventsOf(ready, first.local) == 0);
+
+        //it can be added again
+        CHECK(backend.add(first.local));
+        descriptors.push_back(first.local);
+        CHECK(waitReady(backend, descriptors).size() == 2);
+    }
+
+    template<typename Backend>
+    void checkMany() {
+        Backend backend;
+        std::vector<Pair> pairs(100);
+        std::vector<int> descriptors;
+
+        for(auto& i : pairs) {
+            CHECK(backend.add(i.local));
+            descriptors.push_back(i.local);
+        }
+        backend.setInterest(tnnf::SELECTOR_READABLE, descriptors);
+
+        Ready expected;
+        for(size_t i = 0; i < pairs.size(); i += 3) {
+            CHECK(write(pairs[i].remote, "x", 1) == 1);
+            expected.push_back(std::make_pair(pairs[i].local, tnnf::SELECTOR_READABLE));
+        }
+        std::sort(expected.begin(), expected.end());
+
+        CHECK(waitReady(backend, descriptors) == expected);
+    }
+
+    template<typename Backend>
+    void checkBackend() {
+        checkTimeout<Backend>();
+        checkReadable<Backend>();
+        checkHangUp<Backend>();
+        checkInterest<Backend>();
+        checkRemove<Backend>();
+        checkMany<Backend>();
+    }
+}
+
+int main() {
+    checkBackend<tnnf::SelectBackend>();
+    checkBackend<tnnf::PollBackend>();
+    checkBackend<tnnf::EpollBackend>();
+
+    return check::result("selector_conformance");
+}
@@ -0,0 +1,182 @@
+/*
+    TimerWheel against a sorted list of the timers: random adds, cancels and advances
+    on every level of the wheel and the overflow list.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../include/tnnf/TimerWheel.hpp"
+#include "Check.hpp"
+
+namespace {
+    typedef std::vector<std::pair<uint64_t, int>> Fired; //tick and key of every call
+
+    const int CALLS = 20; //a periodic timer cancels itself at this call, so a long advance stays short
+
+    // The reference: every timer in a list, the earliest is searched on every step.
+    struct Reference {
+        struct Timer {
+            int key;
+            uint64_t expiry, interval;
+            tnnf::TimerId id;
+            int calls;
+        };
+
+        std::vector<Timer> timers;
+        uint64_t now = 0;
+
+        void add(const int& key, const uint64_t& expiry, const uint64_t& interval, const tnnf::TimerId& id) {
+            timers.push_back(Timer{key, std::max(expiry, now + 1), interval, id, 0});
+        }
+
+        bool cancel(const tnnf::TimerId& id) {
+            for(size_t i = 0; i < timers.size(); i++) {
+                if(timers[i].id == id) {
+                    timers.erase(timers.begin() + i);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void advance(const uint64_t& to, Fired& fired) {
+            while(!timers.empty()) {
+                std::stable_sort(timers.begin(), timers.end(), [](const Timer& a, const Timer& b) {
+                    return a.expiry < b.expiry;
+                });
+                if(timers[0].expiry > to) {
+                    break;
+                }
+
+                now = timers[0].expiry;
+                fired.push_back(std::make_pair(now, timers[0].key));
+
+                if(timers[0].interval > 0 && ++timers[0].calls < CALLS) {
+                    timers[0].expiry += timers[0].interval;
+                }
+                else {
+                    timers.erase(timers.begin());
+                }
+            }
+            now = std::max(now, to);
+        }
+
+        uint64_t earliest() const {
+            uint64_t result = std::numeric_limits<uint64_t>::max();
+            for(auto& i : timers) {
+                result = std::min(result, i.expiry);
+            }
+            return result;
+        }
+    };
+
+    void checkRandom(const unsigned int& seed) {
+        std::mt19937_64 random(seed);
+        tnnf::TimerWheel wheel;
+        Reference reference;
+        Fired fired;
+        std::vector<tnnf::TimerId> ids;
+        std::vector<int> calls;
+
+        //delays on every level: up to 64, 4096, 2^18, 2^24, 2^30 ticks, and beyond
+        const uint64_t ranges[] = {64, 4096, 1 << 18, 1 << 24, 1 << 30, 1ULL << 33};
+
+        for(int step = 0; step < 3000; step++) {
+            unsigned int action = random() % 10;
+
+            if(action < 5) {
+                uint64_t range = ranges[random() % 6];
+                uint64_t expiry = wheel.getNow() + random() % range;
+                uint64_t interval = random() % 4 == 0 ? 1 + random() % range : 0;
+                int key = ids.size();
+
+                tnnf::TimerId id = wheel.add(expiry, [&fired, &wheel, &ids, &calls, key]() {
+                    fired.push_back(std::make_pair(wheel.getNow(), key));
+                    if(++calls[key] == CALLS) {
+                        CHECK(wheel.cancel(ids[key]));
+                    }
+                }, interval);
+                ids.push_back(id);
+                calls.push_back(0);
+                reference.add(key, expiry, interval, id);
+            }
+            else if(action < 7 && !reference.timers.empty()) {
+                tnnf::TimerId id = reference.timers[random() % reference.timers.size()].id;
+                CHECK(wheel.cancel(id));
+                CHECK(reference.cancel(id));
+                CHECK(!wheel.cancel(id)); //the second time it is unknown
+            }
+            else {
+                uint64_t to = wheel.getNow() + random() % ranges[random() % 6];
+                Fired expected;
+
+                fired.clear();
+                wheel.advance(to);
+                reference.advance(to, expected);
+
+                std::sort(fired.begin(), fired.end()); //the order inside a tick is not specified
+                std::sort(expected.begin(), expected.end());
+                CHECK(fired == expected);
+                CHECK(wheel.getNow() == reference.now);
+            }
+
+            CHECK(wheel.getSize() == reference.timers.size());
+            CHECK(wheel.getNextTick() <= reference.earliest());
+            CHECK(wheel.getNextTick() > wheel.getNow());
+        }
+    }
+
+    void checkCancelFromCallback() {
+        tnnf::TimerWheel wheel;
+        int calls = 0, other = 0;
+        tnnf::TimerId self = 0, victim = 0;
+
+        victim = wheel.add(10, [&other]() { other++; });
+        self = wheel.add(5, [&]() {
+            calls++;
+            CHECK(wheel.cancel(self));
+            CHECK(wheel.cancel(victim));
+        }, 5);
+
+        wheel.advance(100);
+        CHECK(calls == 1);
+        CHECK(other == 0);
+        CHECK(wheel.getSize() == 0);
+        CHECK(!wheel.cancel(self));
+        CHECK(wheel.getNextTick() == std::numeric_limits<uint64_t>::max());
+
+        //the freed nodes are reused with a new generation, the old ids stay unknown
+        tnnf::TimerId reused = wheel.add(200, []() {});
+        CHECK(reused != self && reused != victim);
+        CHECK(!wheel.cancel(victim));
+        CHECK(wheel.cancel(reused));
+    }
+
+    void checkPast() {
+        tnnf::TimerWheel wheel;
+        uint64_t tick = 0;
+
+        wheel.advance(1000);
+        wheel.add(3, [&]() { tick = wheel.getNow(); }); //in the past, called at the next tick
+
+        wheel.advance(1000);
+        CHECK(tick == 0);
+        wheel.advance(1001);
+        CHECK(tick == 1001);
+    }
+}
+
+int main() {
+    for(unsigned int seed = 1; seed <= 20; seed++) {
+        checkRandom(seed);
+    }
+    checkCancelFromCallback();
+    checkPast();
+
+    return check::result("timerwheel");
+}
@@ -0,0 +1,104 @@
+/*
+    WorkerPool: many strands submitted from one thread, their packets are handled in order,
+    never at the same time, and all of them.
+*/
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/tnnf/WorkerPool.hpp"
+#include "../include/tnnf/TcpSocket.hpp"
+#include "Check.hpp"
+
+namespace {
+    // What the handler has seen of a strand. The workers only count the violations, they are checked on the main thread.
+    struct Seen {
+        std::atomic<bool> busy; //a packet of the strand is being handled
+        std::atomic<size_t> next; //sequence number of the next packet
+        std::atomic<size_t> concurrent;
+        std::atomic<size_t> unordered;
+
+        Seen() : busy(false), next(0), concurrent(0), unordered(0) {}
+    };
+
+    void checkStrands(const size_t& workers, const size_t& strandCount, const size_t& packets) {
+        int fds[2];
+        CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        tnnf::EpollSelector selector(nullptr, nullptr, nullptr);
+        tnnf::TcpSocket sock = tnnf::TcpSocket::FromDescriptor(fds[0]);
+        selector.add(sock);
+
+        std::unique_ptr<Seen[]> seen(new Seen[strandCount]);
+        std::atomic<size_t> handled(0);
+
+        tnnf::WorkerPool pool([&seen, &handled](tnnf::Packet& packet, tnnf::PacketReply&) {
+            Seen& strand = seen[packet.getType()];
+
+            if(strand.busy.exchange(true, std::memory_order_acq_rel)) {
+                strand.concurrent++;
+            }
+            if(std::stoul(packet.getData()) != strand.next.load(std::memory_order_relaxed)) {
+                strand.unordered++;
+            }
+            strand.next.fetch_add(1, std::memory_order_relaxed);
+            if(strand.next % 7 == 0) {
+                std::this_thread::yield(); //a slow packet, so the others can steal
+            }
+
+            strand.busy.store(false, std::memory_order_release);
+            handled.fetch_add(1, std::memory_order_relaxed);
+        }, workers);
+        pool.start();
+
+        std::vector<std::shared_ptr<tnnf::Strand>> strands;
+        std::vector<size_t> sequences(strandCount, 0);
+        for(size_t i = 0; i < strandCount; i++) {
+            strands.push_back(pool.makeStrand());
+        }
+
+        //bursts of random length to random strands, some are scheduled while they are handled
+        std::mt19937 random(strandCount);
+        size_t submitted = 0;
+        while(submitted < packets) {
+            size_t index = random() % strandCount;
+            size_t burst = 1 + random() % 40;
+
+            for(size_t i = 0; i < burst && submitted < packets; i++, submitted++) {
+                pool.submit(strands[index], selector, sock, tnnf::Packet(index, std::to_string(sequences[index]++)));
+            }
+        }
+
+        for(int i = 0; i < 10000 && handled.load() < packets; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(handled.load() == packets);
+
+        for(size_t i = 0; i < strandCount; i++) {
+            CHECK(seen[i].concurrent == 0);
+            CHECK(seen[i].unordered == 0);
+            CHECK(seen[i].next == sequences[i]);
+            CHECK(strands[i]->getCount() == 0);
+        }
+
+        pool.stop();
+        selector.removeAll();
+        close(fds[1]);
+    }
+}
+
+int main() {
+    checkStrands(4, 64, 200000);
+    checkStrands(8, 1, 20000); //one busy strand is handed back after every batch
+    checkStrands(1, 16, 20000);
+
+    return check::result("workerpool");
+}